@@ -4,6 +4,9 @@
 #include <iostream>
 #include <random>
 #include <string_view>
+#include <vector>
+
+#include "csp/batch.hpp"
 
 #ifdef __GNUC__
 #include <cxxabi.h>
@@ -89,6 +92,26 @@ static void showcaseOperators() {
     }
 }
 
+/// Visits many animals of random types. `visit_batch` groups them by type
+/// first, so the visitor runs in one tight loop per animal kind instead of
+/// mispredicting an indirect call for every animal.
+static void showcaseBatchVisit() {
+    std::vector<DynUniquePtr<Animal>> animals;
+    for (int i = 0; i < 1000; ++i) {
+        animals.push_back(generateAnimal());
+    }
+    std::array<int, 3> counts{};
+    // clang-format off
+    visit_batch(animals, overload{
+        [&](Mammal const&) { ++counts[0]; },
+        [&](Dolphin const&) { ++counts[1]; },
+        [&](Fish const&) { ++counts[1]; },
+        [&](Bird const&) { ++counts[2]; },
+    }); // clang-format on
+    std::cout << counts[0] << " animals live on land, " << counts[1]
+              << " in water and " << counts[2] << " in the air.\n";
+}
+
 void showcaseMultipleDispatch(Animal const& animal1, Animal const& animal2) {
     visit(animal1, animal2,
           overload{
@@ -113,5 +136,6 @@ void showcaseMultipleDispatch(Animal const& animal1, Animal const& animal2) {
 int main() {
     printHabitats();
     showcaseOperators();
+    showcaseBatchVisit();
     showcaseMultipleDispatch(Cat(), Goldfish());
 }
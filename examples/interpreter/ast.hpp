@@ -6,9 +6,17 @@
 #include <algorithm>
 #include <cassert>
 #include <concepts>
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <memory_resource>
+#include <new>
+#include <optional>
 #include <ranges>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 #include "csp.hpp"
@@ -36,6 +44,8 @@ namespace examples {
 AST_LIST(X)
 #undef X
 
+struct Builtin;
+
 enum class ASTNodeID {
 #define X(Name, ...) Name,
     AST_LIST(X)
@@ -57,32 +67,112 @@ namespace examples {
 template <typename T>
 using DynUniquePtr = std::unique_ptr<T, csp::dyn_deleter>;
 
+/// Owns the memory of the nodes of one program. Nodes don't own their
+/// children, so all nodes except `Program` are trivially destructible and
+/// their memory is released without visiting them.
+class ASTStorage {
+public:
+    enum Mode {
+        /// Every node is a separate heap allocation
+        Heap,
+
+        /// All nodes are allocated from one arena that is released at once
+        Arena
+    };
+
+    /// \p sizeHint is the initial size of the arena in arena mode
+    explicit ASTStorage(Mode mode, size_t sizeHint = 0) {
+        if (mode == Arena) {
+            m_arena.emplace(std::max(sizeHint, size_t(256)));
+        }
+    }
+
+    ASTStorage(ASTStorage const&) = delete;
+    ASTStorage& operator=(ASTStorage const&) = delete;
+
+    ~ASTStorage() {
+        for (auto [address, size, align] : m_allocations) {
+            std::pmr::new_delete_resource()->deallocate(address, size, align);
+        }
+    }
+
+    Mode mode() const { return m_arena ? Arena : Heap; }
+
+    /// Allocates and constructs a node of type \p T
+    template <typename T, typename... Args>
+    requires std::constructible_from<T, Args...>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return ::new (allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+    }
+
+    /// Allocates an array of \p count child pointers
+    std::span<ASTNode*> makeChildArray(size_t count) {
+        auto* data = static_cast<ASTNode**>(
+            allocate(count * sizeof(ASTNode*), alignof(ASTNode*)));
+        return { data, count };
+    }
+
+    /// \Returns a copy of \p text that lives as long as the storage
+    std::string_view copyString(std::string_view text) {
+        auto* data = static_cast<char*>(allocate(text.size(), 1));
+        std::copy(text.begin(), text.end(), data);
+        return { data, text.size() };
+    }
+
+private:
+    struct Allocation {
+        void* address;
+        size_t size;
+        size_t align;
+    };
+
+    void* allocate(size_t size, size_t align) {
+        if (m_arena) {
+            return m_arena->allocate(size, align);
+        }
+        void* address = std::pmr::new_delete_resource()->allocate(size, align);
+        m_allocations.push_back({ address, size, align });
+        return address;
+    }
+
+    std::optional<std::pmr::monotonic_buffer_resource> m_arena;
+    std::vector<Allocation> m_allocations;
+};
+
+/// Nodes are allocated by an `ASTStorage` and refer to their children through
+/// raw pointers. Nodes with a fixed number of children store the pointers
+/// inline, the others store them in an array allocated by the storage.
 class ASTNode: public csp::base_helper<ASTNode> {
 public:
+    ASTNode(ASTNode const&) = delete;
+    ASTNode& operator=(ASTNode const&) = delete;
+
     template <typename T = ASTNode>
     T* childAt(size_t index) const {
         assert(index < numChildren());
-        return csp::cast<T*>(m_children[index].get());
+        return csp::cast<T*>(m_children[index]);
     }
 
     size_t numChildren() const { return m_children.size(); }
 
-    auto children() const {
-        return m_children |
-               std::views::transform([](auto& p) { return p.get(); });
+    /// \Returns the children, which are stored contiguously
+    std::span<ASTNode* const> children() const { return m_children; }
+
+    /// Replaces the child at \p index by \p child. The old child stays
+    /// allocated until the storage is destroyed
+    void setChild(size_t index, ASTNode* child) {
+        assert(index < numChildren());
+        m_children[index] = child;
     }
 
 protected:
-    ASTNode(ASTNodeID ID, std::vector<DynUniquePtr<ASTNode>> children):
-        base_helper(ID), m_children(std::move(children)) {}
-
-    template <typename... Children>
-    ASTNode(ASTNodeID ID, Children&&... children): ASTNode(ID, {}) {
-        (m_children.push_back(std::forward<Children>(children)), ...);
-    }
+    explicit ASTNode(ASTNodeID ID, std::span<ASTNode*> children = {}):
+        base_helper(ID), m_children(children) {}
 
 private:
-    std::vector<DynUniquePtr<ASTNode>> m_children;
+    std::span<ASTNode*> m_children;
 };
 
 class Expr: public ASTNode {
@@ -92,13 +182,24 @@ protected:
 
 class Identifier: public Expr {
 public:
-    explicit Identifier(std::string value):
-        Expr(ASTNodeID::Identifier), m_value(std::move(value)) {}
+    static constexpr uint32_t NoSlot = ~uint32_t(0);
+
+    /// \p value must outlive the node. The parser copies it into the
+    /// `ASTStorage` of the program
+    explicit Identifier(std::string_view value):
+        Expr(ASTNodeID::Identifier), m_value(value) {}
+
+    std::string_view value() const { return m_value; }
+
+    /// The index of the variable in the `SymbolTable` the program was parsed
+    /// with, or `NoSlot` if the identifier names a function
+    uint32_t slot() const { return m_slot; }
 
-    std::string value() const { return m_value; }
+    void setSlot(uint32_t slot) { m_slot = slot; }
 
 private:
-    std::string m_value;
+    std::string_view m_value;
+    uint32_t m_slot = NoSlot;
 };
 
 class Literal: public Expr {
@@ -115,9 +216,9 @@ class BinaryExpr: public Expr {
 public:
     enum Operator { Add, Sub, Mul, Div, Pow };
 
-    explicit BinaryExpr(Operator op, DynUniquePtr<Expr> lhs,
-                        DynUniquePtr<Expr> rhs):
-        Expr(ASTNodeID::BinaryExpr, std::move(lhs), std::move(rhs)),
+    explicit BinaryExpr(Operator op, Expr* lhs, Expr* rhs):
+        Expr(ASTNodeID::BinaryExpr, m_operands),
+        m_operands{ lhs, rhs },
         m_operator(op) {}
 
     Operator getOperator() const { return m_operator; }
@@ -127,6 +228,7 @@ public:
     Expr* rhs() const { return childAt<Expr>(1); }
 
 private:
+    ASTNode* m_operands[2];
     Operator m_operator;
 };
 
@@ -134,23 +236,27 @@ class UnaryExpr: public Expr {
 public:
     enum Operator { Promote, Negate };
 
-    explicit UnaryExpr(Operator op, DynUniquePtr<Expr> operand):
-        Expr(ASTNodeID::UnaryExpr, std::move(operand)), m_operator(op) {}
+    explicit UnaryExpr(Operator op, Expr* operand):
+        Expr(ASTNodeID::UnaryExpr, m_operands),
+        m_operands{ operand },
+        m_operator(op) {}
 
     Operator getOperator() const { return m_operator; }
 
     Expr* operand() const { return childAt<Expr>(0); }
 
 private:
+    ASTNode* m_operands[1];
     Operator m_operator;
 };
 
 class CallExpr: public Expr {
 public:
-    explicit CallExpr(DynUniquePtr<Expr> callee,
-                      std::vector<DynUniquePtr<Expr>> arguments):
-        Expr(ASTNodeID::CallExpr,
-             makeChildren(std::move(callee), std::move(arguments))) {}
+    /// \p children holds the callee followed by the arguments
+    explicit CallExpr(std::span<ASTNode*> children):
+        Expr(ASTNodeID::CallExpr, children) {
+        assert(!children.empty());
+    }
 
     Expr* callee() const { return childAt<Expr>(0); }
 
@@ -159,17 +265,19 @@ public:
                std::views::transform(csp::cast<Expr*>);
     }
 
-private:
-    static std::vector<DynUniquePtr<ASTNode>>
-    makeChildren(DynUniquePtr<Expr> callee,
-                 std::vector<DynUniquePtr<Expr>> arguments) {
-        std::vector<DynUniquePtr<ASTNode>> children;
-        children.reserve(arguments.size() + 1);
-        children.push_back(std::move(callee));
-        children.insert(children.end(), std::move_iterator(arguments.begin()),
-                        std::move_iterator(arguments.end()));
-        return children;
+    /// \Returns the arguments, which are stored contiguously
+    std::span<ASTNode* const> argumentSpan() const {
+        return children().subspan(1);
     }
+
+    /// The function that the callee names. Set by the parser, which rejects
+    /// calls of unknown functions and calls with the wrong number of arguments
+    Builtin const* builtin() const { return m_builtin; }
+
+    void setBuiltin(Builtin const* builtin) { m_builtin = builtin; }
+
+private:
+    Builtin const* m_builtin = nullptr;
 };
 
 class Statement: public ASTNode {
@@ -184,13 +292,16 @@ public:
 
 class VarDecl: public Statement {
 public:
-    explicit VarDecl(DynUniquePtr<Identifier> name,
-                     DynUniquePtr<Expr> initExpr):
-        Statement(ASTNodeID::VarDecl, std::move(name), std::move(initExpr)) {}
+    explicit VarDecl(Identifier* name, Expr* initExpr):
+        Statement(ASTNodeID::VarDecl, m_operands),
+        m_operands{ name, initExpr } {}
 
     Identifier* name() const { return childAt<Identifier>(0); }
 
     Expr* initExpr() const { return childAt<Expr>(1); }
+
+private:
+    ASTNode* m_operands[2];
 };
 
 class InstrStatement: public Statement {
@@ -198,9 +309,8 @@ public:
     enum Instruction { Print, Quit };
 
     explicit InstrStatement(Instruction instr,
-                            std::vector<DynUniquePtr<ASTNode>> operands):
-        Statement(ASTNodeID::InstrStatement, std::move(operands)),
-        m_instr(instr) {}
+                            std::span<ASTNode*> operands):
+        Statement(ASTNodeID::InstrStatement, operands), m_instr(instr) {}
 
     Instruction instruction() const { return m_instr; }
 
@@ -216,20 +326,68 @@ private:
 
 class ExprStatement: public Statement {
 public:
-    explicit ExprStatement(DynUniquePtr<Expr> expr):
-        Statement(ASTNodeID::ExprStatement, std::move(expr)) {}
+    explicit ExprStatement(Expr* expr):
+        Statement(ASTNodeID::ExprStatement, m_operands), m_operands{ expr } {}
 
     Expr* expr() const { return childAt<Expr>(0); }
+
+private:
+    ASTNode* m_operands[1];
 };
 
+/// Root of the AST. Owns the storage of all other nodes
 class Program: public ASTNode {
 public:
-    explicit Program(std::vector<DynUniquePtr<ASTNode>> children):
-        ASTNode(ASTNodeID::Program, std::move(children)) {}
+    explicit Program(std::unique_ptr<ASTStorage> storage,
+                     std::span<ASTNode*> statements):
+        ASTNode(ASTNodeID::Program, statements), m_storage(std::move(storage)) {}
 
     auto statements() const {
         return children() | std::views::transform(csp::cast<Statement*>);
     }
+
+    ASTStorage& storage() { return *m_storage; }
+
+    ASTStorage const& storage() const { return *m_storage; }
+
+    /// Size of the `SymbolTable` after the program was parsed. All slots of the
+    /// identifiers in the program are smaller
+    size_t numSlots() const { return m_numSlots; }
+
+    void setNumSlots(size_t numSlots) { m_numSlots = numSlots; }
+
+private:
+    std::unique_ptr<ASTStorage> m_storage;
+    size_t m_numSlots = 0;
+};
+
+/// Assigns dense slot indices to variable names. Programs parsed with the same
+/// table agree on the slots, so variables can be stored in a flat array that
+/// persists across programs.
+class SymbolTable {
+public:
+    /// \Returns the slot of \p name. Unknown names are assigned the next slot
+    uint32_t slot(std::string_view name) {
+        auto itr = m_slots.find(name);
+        if (itr == m_slots.end()) {
+            itr = m_slots.emplace(name, (uint32_t)m_names.size()).first;
+            m_names.push_back(itr->first);
+        }
+        return itr->second;
+    }
+
+    /// \Returns the name of the variable in \p slot
+    std::string const& name(uint32_t slot) const {
+        assert(slot < size());
+        return m_names[slot];
+    }
+
+    /// \Returns the number of slots
+    size_t size() const { return m_names.size(); }
+
+private:
+    std::map<std::string, uint32_t, std::less<>> m_slots;
+    std::vector<std::string> m_names;
 };
 
 } // namespace examples
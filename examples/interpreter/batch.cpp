@@ -0,0 +1,187 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "builtins.hpp"
+
+using namespace examples;
+using namespace csp;
+
+namespace {
+
+template <BinaryExpr::Operator Op, typename T>
+T apply(T lhs, T rhs) {
+    using enum BinaryExpr::Operator;
+    if constexpr (Op == Add) {
+        return lhs + rhs;
+    }
+    else if constexpr (Op == Sub) {
+        return lhs - rhs;
+    }
+    else if constexpr (Op == Mul) {
+        return lhs * rhs;
+    }
+    else if constexpr (Op == Div) {
+        return lhs / rhs;
+    }
+    else {
+        return std::pow(lhs, rhs);
+    }
+}
+
+#if defined(__SSE2__)
+
+template <BinaryExpr::Operator Op>
+__m128d apply(__m128d lhs, __m128d rhs) {
+    using enum BinaryExpr::Operator;
+    if constexpr (Op == Add) {
+        return _mm_add_pd(lhs, rhs);
+    }
+    else if constexpr (Op == Sub) {
+        return _mm_sub_pd(lhs, rhs);
+    }
+    else if constexpr (Op == Mul) {
+        return _mm_mul_pd(lhs, rhs);
+    }
+    else {
+        static_assert(Op == Div);
+        return _mm_div_pd(lhs, rhs);
+    }
+}
+
+#endif
+
+/// Computes `result[i] = lhs[i] Op rhs[i]`. \p result may alias the operands
+template <BinaryExpr::Operator Op>
+void binaryColumn(double const* lhs, double const* rhs, double* result,
+                  size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    if constexpr (Op != BinaryExpr::Pow) {
+        for (; i + 2 <= count; i += 2) {
+            __m128d value =
+                apply<Op>(_mm_loadu_pd(lhs + i), _mm_loadu_pd(rhs + i));
+            _mm_storeu_pd(result + i, value);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        result[i] = apply<Op>(lhs[i], rhs[i]);
+    }
+}
+
+void negateColumn(double const* operand, double* result, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        result[i] = -operand[i];
+    }
+}
+
+} // namespace
+
+void BatchEvaluator::bind(uint32_t slot, std::span<double const> values) {
+    if (bindings.size() <= slot) {
+        bindings.resize(slot + 1);
+    }
+    bindings[slot] = values;
+}
+
+void BatchEvaluator::eval(Expr const& expr, std::span<double> result) {
+    for (size_t first = 0; first < result.size(); first += BlockSize) {
+        Block block{ first, std::min(BlockSize, result.size() - first) };
+        double const* values = evalColumn(expr, 0, block);
+        std::copy_n(values, block.count, result.data() + first);
+    }
+}
+
+double const* BatchEvaluator::evalColumn(Expr const& expr, size_t depth,
+                                         Block block) {
+    return visit(expr, [&](auto& expr) {
+        return doEvalColumn(expr, depth, block);
+    });
+}
+
+double const* BatchEvaluator::doEvalColumn(Identifier const& ID, size_t,
+                                           Block block) {
+    uint32_t slot = ID.slot();
+    if (slot >= bindings.size() || !bindings[slot]) {
+        throw std::runtime_error("Use of unbound identifier: " +
+                                 std::string(ID.value()));
+    }
+    auto values = *bindings[slot];
+    if (values.size() < block.first + block.count) {
+        throw std::runtime_error("Too few values bound to identifier: " +
+                                 std::string(ID.value()));
+    }
+    /// Variables are read in place
+    return values.data() + block.first;
+}
+
+double const* BatchEvaluator::doEvalColumn(Literal const& lit, size_t depth,
+                                           Block block) {
+    double* result = column(depth);
+    std::fill_n(result, block.count, lit.value());
+    return result;
+}
+
+double const* BatchEvaluator::doEvalColumn(BinaryExpr const& expr,
+                                           size_t depth, Block block) {
+    double const* lhs = evalColumn(*expr.lhs(), depth, block);
+    double const* rhs = evalColumn(*expr.rhs(), depth + 1, block);
+    double* result = column(depth);
+    switch (expr.getOperator()) {
+#define CASE(Op)                                                               \
+    case BinaryExpr::Op:                                                       \
+        binaryColumn<BinaryExpr::Op>(lhs, rhs, result, block.count);           \
+        break;
+        CASE(Add)
+        CASE(Sub)
+        CASE(Mul)
+        CASE(Div)
+        CASE(Pow)
+#undef CASE
+    }
+    return result;
+}
+
+double const* BatchEvaluator::doEvalColumn(UnaryExpr const& expr,
+                                           size_t depth, Block block) {
+    double const* operand = evalColumn(*expr.operand(), depth, block);
+    switch (expr.getOperator()) {
+    case UnaryExpr::Promote: return operand;
+    case UnaryExpr::Negate: {
+        double* result = column(depth);
+        negateColumn(operand, result, block.count);
+        return result;
+    }
+    }
+    assert(false && "Invalid operator");
+    return nullptr;
+}
+
+double const* BatchEvaluator::doEvalColumn(CallExpr const& call, size_t depth,
+                                           Block block) {
+    double const* args[MaxBuiltinArity];
+    auto argSpan = call.argumentSpan();
+    for (size_t index = 0; index < argSpan.size(); ++index) {
+        args[index] =
+            evalColumn(*cast<Expr const*>(argSpan[index]), depth + index, block);
+    }
+    double* result = column(depth);
+    call.builtin()->columnFunction(args, result, block.count);
+    return result;
+}
+
+double* BatchEvaluator::column(size_t depth) {
+    while (columns.size() <= depth) {
+        columns.push_back(std::make_unique<Column>());
+    }
+    return columns[depth]->data();
+}
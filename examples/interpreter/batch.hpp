@@ -0,0 +1,66 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+/// This file defines an evaluator that computes an expression for many rows of
+/// variable values at once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "ast.hpp"
+
+namespace examples {
+
+/// Evaluates expressions over columns of variable values. Rows are processed in
+/// blocks of `BlockSize`, and every node is dispatched once per block and
+/// applies its operation to whole columns. This way the cost of walking the
+/// tree is shared by all rows of a block and the loops over the columns can
+/// use SIMD instructions.
+class BatchEvaluator {
+public:
+    static constexpr size_t BlockSize = 256;
+
+    /// Binds the variable in \p slot of the `SymbolTable` that the expressions
+    /// are parsed with to \p values. \p values must outlive the evaluation and
+    /// have at least as many rows as are evaluated
+    void bind(uint32_t slot, std::span<double const> values);
+
+    /// Evaluates \p expr for every row and writes the results to \p result,
+    /// which has one element per row. Throws `std::runtime_error` if \p expr
+    /// reads a variable that is not bound or has too few rows
+    void eval(Expr const& expr, std::span<double> result);
+
+private:
+    using Column = std::array<double, BlockSize>;
+
+    struct Block {
+        size_t first;
+        size_t count;
+    };
+
+    double const* evalColumn(Expr const& expr, size_t depth, Block block);
+
+    double const* doEvalColumn(Identifier const& ID, size_t depth, Block block);
+    double const* doEvalColumn(Literal const& lit, size_t depth, Block block);
+    double const* doEvalColumn(BinaryExpr const& expr, size_t depth,
+                               Block block);
+    double const* doEvalColumn(UnaryExpr const& expr, size_t depth,
+                               Block block);
+    double const* doEvalColumn(CallExpr const& call, size_t depth, Block block);
+
+    /// \Returns the scratch column of the nodes at \p depth. Children of a
+    /// node are evaluated at larger depths, so they don't overwrite the
+    /// columns that their parents are still reading
+    double* column(size_t depth);
+
+    std::vector<std::optional<std::span<double const>>> bindings;
+    std::vector<std::unique_ptr<Column>> columns;
+};
+
+} // namespace examples
+
+#endif // BATCH_HPP
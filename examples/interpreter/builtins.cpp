@@ -0,0 +1,76 @@
+#include "builtins.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace examples;
+
+namespace {
+
+template <auto F>
+constexpr Builtin unary(std::string_view name) {
+    return { name, 1, [](double const* args) { return F(args[0]); },
+             [](double const* const* args, double* result, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            result[i] = F(args[0][i]);
+        }
+    } };
+}
+
+template <auto F>
+constexpr Builtin binary(std::string_view name) {
+    return { name, 2, [](double const* args) { return F(args[0], args[1]); },
+             [](double const* const* args, double* result, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            result[i] = F(args[0][i], args[1][i]);
+        }
+    } };
+}
+
+/// `std::sqrt` has to set `errno` for negative arguments, which keeps
+/// compilers from vectorizing the loop in `unary()`
+void sqrtColumn(double const* const* args, double* result, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(result + i, _mm_sqrt_pd(_mm_loadu_pd(args[0] + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        result[i] = std::sqrt(args[0][i]);
+    }
+}
+
+constexpr Builtin makeSqrt() {
+    auto sqrt = unary<[](double x) { return std::sqrt(x); }>("sqrt");
+    sqrt.columnFunction = sqrtColumn;
+    return sqrt;
+}
+
+} // namespace
+
+static constexpr Builtin Builtins[] = {
+    makeSqrt(),
+    binary<[](double x, double y) { return std::pow(x, y); }>("pow"),
+    unary<[](double x) { return std::exp(x); }>("exp"),
+    unary<[](double x) { return std::exp2(x); }>("exp2"),
+    unary<[](double x) { return std::log(x); }>("log"),
+    unary<[](double x) { return std::log2(x); }>("log2"),
+};
+
+static_assert(std::ranges::all_of(Builtins, [](Builtin const& builtin) {
+    return builtin.arity <= MaxBuiltinArity;
+}));
+
+std::span<Builtin const> examples::builtins() {
+    return Builtins;
+}
+
+Builtin const* examples::findBuiltin(std::string_view name) {
+    auto* itr = std::ranges::find(Builtins, name, &Builtin::name);
+    return itr != std::end(Builtins) ? itr : nullptr;
+}
@@ -0,0 +1,39 @@
+#ifndef BUILTINS_HPP
+#define BUILTINS_HPP
+
+/// This file declares the math functions that programs can call
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace examples {
+
+struct Builtin {
+    std::string_view name;
+
+    /// Number of arguments
+    size_t arity;
+
+    /// Invoked with a pointer to `arity` contiguous arguments
+    double (*function)(double const* args);
+
+    /// Invoked with `arity` columns of \p count arguments each. Writes the
+    /// \p count results to \p result, which may be one of the argument
+    /// columns
+    void (*columnFunction)(double const* const* args, double* result,
+                           size_t count);
+};
+
+/// The largest arity of all builtins
+inline constexpr size_t MaxBuiltinArity = 2;
+
+/// \Returns all builtin functions
+std::span<Builtin const> builtins();
+
+/// \Returns the builtin named \p name or `nullptr` if there is none
+Builtin const* findBuiltin(std::string_view name);
+
+} // namespace examples
+
+#endif // BUILTINS_HPP
@@ -0,0 +1,231 @@
+#include "bytecode.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+#include "builtins.hpp"
+
+/// GCC and Clang support taking the address of labels, which lets every
+/// instruction jump directly to the next handler instead of going back through
+/// a switch statement
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO 1
+#else
+#define VM_COMPUTED_GOTO 0
+#endif
+
+using namespace examples;
+using namespace csp;
+
+namespace {
+
+class Compiler {
+public:
+    Bytecode run(Program const& program) {
+        for (auto* stmt : program.statements()) {
+            visit(*stmt, [&](auto& stmt) { compile(stmt); });
+        }
+        emit(OpCode::Halt, 0, 0);
+        return std::move(result);
+    }
+
+private:
+    void compile(EmptyStatement const&) {}
+
+    void compile(VarDecl const& decl) {
+        compileExpr(*decl.initExpr());
+        emit(OpCode::Store, decl.name()->slot(), -1);
+    }
+
+    void compile(InstrStatement const& stmt) {
+        using enum InstrStatement::Instruction;
+        switch (stmt.instruction()) {
+        case Print:
+            for (auto* arg : stmt.operands()) {
+                compileExpr(*arg);
+                emit(OpCode::Print, 0, -1);
+            }
+            break;
+        case Quit: emit(OpCode::Quit, 0, 0); break;
+        }
+    }
+
+    void compile(ExprStatement const& stmt) {
+        compileExpr(*stmt.expr());
+        emit(OpCode::Eval, 0, -1);
+    }
+
+    void compileExpr(Expr const& expr) {
+        visit(expr, [&](auto& expr) { compile(expr); });
+    }
+
+    void compile(Identifier const& ID) {
+        result.names.insert({ ID.slot(), std::string(ID.value()) });
+        emit(OpCode::Load, ID.slot(), 1);
+    }
+
+    void compile(Literal const& lit) {
+        result.constants.push_back(lit.value());
+        emit(OpCode::PushConst, uint32_t(result.constants.size() - 1), 1);
+    }
+
+    void compile(BinaryExpr const& expr) {
+        compileExpr(*expr.lhs());
+        compileExpr(*expr.rhs());
+        emit(toOpCode(expr.getOperator()), 0, -1);
+    }
+
+    static OpCode toOpCode(BinaryExpr::Operator op) {
+        switch (op) {
+            using enum BinaryExpr::Operator;
+        case Add: return OpCode::Add;
+        case Sub: return OpCode::Sub;
+        case Mul: return OpCode::Mul;
+        case Div: return OpCode::Div;
+        case Pow: return OpCode::Pow;
+        }
+        assert(false && "Invalid operator");
+        return OpCode::Add;
+    }
+
+    void compile(UnaryExpr const& expr) {
+        compileExpr(*expr.operand());
+        switch (expr.getOperator()) {
+            using enum UnaryExpr::Operator;
+        case Promote: break;
+        case Negate: emit(OpCode::Neg, 0, 0); break;
+        }
+    }
+
+    void compile(CallExpr const& call) {
+        for (auto* arg : call.arguments()) {
+            compileExpr(*arg);
+        }
+        size_t arity = call.builtin()->arity;
+        emit(OpCode::Call, uint32_t(call.builtin() - builtins().data()),
+             1 - (int)arity);
+    }
+
+    void emit(OpCode op, uint32_t arg, int stackEffect) {
+        result.code.push_back({ op, arg });
+        depth += stackEffect;
+        result.maxStackSize = std::max(result.maxStackSize, depth);
+    }
+
+    Bytecode result;
+    size_t depth = 0;
+};
+
+} // namespace
+
+Bytecode examples::compile(Program const& program) {
+    return Compiler{}.run(program);
+}
+
+void examples::execute(Bytecode const& code, InterpreterDelegate& delegate,
+                       Variables& variables) {
+    double* values = variables.values.data();
+    uint8_t* declared = variables.declared.data();
+    std::vector<double> stack(code.maxStackSize);
+    /// Points past the top of the stack
+    double* sp = stack.data();
+    Instruction const* ip = code.code.data();
+    Instruction const* inst = nullptr;
+    double const* constants = code.constants.data();
+    Builtin const* builtinTable = builtins().data();
+
+#if VM_COMPUTED_GOTO
+    static void* const DispatchTable[] = {
+#define X(Name) &&L_##Name,
+        OPCODE_LIST(X)
+#undef X
+    };
+#define CASE(Name) L_##Name:
+#define DISPATCH()                                                             \
+    inst = ip++;                                                               \
+    goto* DispatchTable[(size_t)inst->op]
+    DISPATCH();
+#else
+#define CASE(Name) case OpCode::Name:
+#define DISPATCH() continue
+    while (true) {
+        inst = ip++;
+        switch (inst->op) {
+#endif
+
+    CASE(PushConst) {
+        *sp++ = constants[inst->arg];
+        DISPATCH();
+    }
+    CASE(Load) {
+        if (!declared[inst->arg]) {
+            throw std::runtime_error("Use of undeclared identifier: " +
+                                     code.names.at(inst->arg));
+        }
+        *sp++ = values[inst->arg];
+        DISPATCH();
+    }
+    CASE(Store) {
+        values[inst->arg] = *--sp;
+        declared[inst->arg] = true;
+        DISPATCH();
+    }
+    CASE(Add) {
+        --sp;
+        sp[-1] += sp[0];
+        DISPATCH();
+    }
+    CASE(Sub) {
+        --sp;
+        sp[-1] -= sp[0];
+        DISPATCH();
+    }
+    CASE(Mul) {
+        --sp;
+        sp[-1] *= sp[0];
+        DISPATCH();
+    }
+    CASE(Div) {
+        --sp;
+        sp[-1] /= sp[0];
+        DISPATCH();
+    }
+    CASE(Pow) {
+        --sp;
+        sp[-1] = std::pow(sp[-1], sp[0]);
+        DISPATCH();
+    }
+    CASE(Neg) {
+        sp[-1] = -sp[-1];
+        DISPATCH();
+    }
+    CASE(Call) {
+        auto& builtin = builtinTable[inst->arg];
+        sp -= builtin.arity;
+        *sp = builtin.function(sp);
+        ++sp;
+        DISPATCH();
+    }
+    CASE(Print) {
+        delegate.print(*--sp);
+        DISPATCH();
+    }
+    CASE(Eval) {
+        delegate.eval(*--sp);
+        DISPATCH();
+    }
+    CASE(Quit) {
+        delegate.quit();
+        DISPATCH();
+    }
+    CASE(Halt) { return; }
+
+#if !VM_COMPUTED_GOTO
+        }
+    }
+#endif
+#undef CASE
+#undef DISPATCH
+}
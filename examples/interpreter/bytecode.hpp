@@ -0,0 +1,77 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+/// This file defines the bytecode that programs are lowered to and the stack
+/// machine that executes it
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ast.hpp"
+#include "interpreter.hpp"
+
+/// X-Macro that lists all opcodes. The virtual machine uses it to build its
+/// dispatch table
+#define OPCODE_LIST(X)                                                         \
+    X(PushConst)                                                               \
+    X(Load)                                                                    \
+    X(Store)                                                                   \
+    X(Add)                                                                     \
+    X(Sub)                                                                     \
+    X(Mul)                                                                     \
+    X(Div)                                                                     \
+    X(Pow)                                                                     \
+    X(Neg)                                                                     \
+    X(Call)                                                                    \
+    X(Print)                                                                   \
+    X(Eval)                                                                    \
+    X(Quit)                                                                    \
+    X(Halt)
+
+namespace examples {
+
+/// - `PushConst` pushes `constants[arg]`
+/// - `Load` pushes the value of the variable in slot `arg`
+/// - `Store` pops a value and assigns it to the variable in slot `arg`
+/// - `Add`, `Sub`, `Mul`, `Div` and `Pow` pop two operands and push the result
+/// - `Neg` negates the top of the stack
+/// - `Call` replaces the arguments on top of the stack by the result of the
+///   builtin function `builtins()[arg]`
+/// - `Print` and `Eval` pop a value and pass it to the `InterpreterDelegate`
+/// - `Quit` calls `InterpreterDelegate::quit()`
+/// - `Halt` ends the execution
+enum class OpCode : uint8_t {
+#define X(Name) Name,
+    OPCODE_LIST(X)
+#undef X
+};
+
+struct Instruction {
+    OpCode op;
+    uint32_t arg = 0;
+};
+
+/// Result of compiling a program
+struct Bytecode {
+    std::vector<Instruction> code;
+    std::vector<double> constants;
+
+    /// Names of the variables that are loaded, for error messages
+    std::map<uint32_t, std::string> names;
+
+    size_t maxStackSize = 0;
+};
+
+/// Lowers \p program to bytecode
+Bytecode compile(Program const& program);
+
+/// Executes \p code. \p variables must have room for all slots used by
+/// \p code
+void execute(Bytecode const& code, InterpreterDelegate& delegate,
+             Variables& variables);
+
+} // namespace examples
+
+#endif // BYTECODE_HPP
@@ -0,0 +1,206 @@
+#include "checks.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "batch.hpp"
+#include "flat_ast.hpp"
+#include "mapped_file.hpp"
+#include "optimizer.hpp"
+#include "parser.hpp"
+#include "utils.hpp"
+
+using namespace examples;
+
+namespace {
+
+/// Collects the values of expression statements
+struct CollectingDelegate: InterpreterDelegate {
+    double value = 0;
+
+    void print(double) override {}
+
+    void eval(double value) override { this->value = value; }
+
+    void quit() override { throw QuitException(); }
+};
+
+/// `true` if the batch result \p batch agrees with the scalar result \p scalar
+bool sameResult(double batch, double scalar) {
+    if (std::isnan(batch) || std::isnan(scalar)) {
+        return std::isnan(batch) && std::isnan(scalar);
+    }
+    return batch == scalar ||
+           std::abs(batch - scalar) <= 1e-12 * std::abs(scalar);
+}
+
+/// Records the printed and evaluated values
+struct RecordingDelegate: InterpreterDelegate {
+    std::vector<double> values;
+
+    void print(double value) override { values.push_back(value); }
+
+    void eval(double value) override { values.push_back(value); }
+
+    void quit() override { throw QuitException(); }
+};
+
+} // namespace
+
+int examples::repeatScript(std::string const& path, Interpreter& interpreter,
+                           InterpreterMode mode, bool optimizeInput,
+                           size_t repeat) {
+    try {
+        MappedFile file(path);
+        auto prog = parse(std::string(file.text()), interpreter.symbols());
+        if (optimizeInput) {
+            optimize(*prog);
+        }
+        size_t firstMisses = 0;
+        try {
+            for (size_t i = 0; i < repeat; ++i) {
+                auto before = interpreter.evalCacheStatistics();
+                interpreter.run(*prog);
+                auto after = interpreter.evalCacheStatistics();
+                size_t hits = after.hits - before.hits;
+                size_t misses = after.misses - before.misses;
+                if (i == 0) {
+                    firstMisses = misses;
+                }
+                /// Every expression misses in the first run, later runs only
+                /// evaluate expressions that read changed variables
+                assert(misses <= firstMisses);
+                if (mode == InterpreterMode::TreeWalk) {
+                    fprintf(stderr, "Run %zu: %zu cached, %zu evaluated\n",
+                            i + 1, hits, misses);
+                }
+            }
+        }
+        catch (...) {
+            interpreter.forget(*prog);
+            throw;
+        }
+        interpreter.forget(*prog);
+    }
+    catch (QuitException const&) {
+    }
+    catch (std::runtime_error const& e) {
+        printError(e.what());
+        return 1;
+    }
+    return 0;
+}
+
+int examples::checkBatch(std::string const& path, InterpreterMode mode,
+                         size_t numRows) {
+    using Clock = std::chrono::steady_clock;
+    try {
+        MappedFile file(path);
+        CollectingDelegate delegate;
+        Interpreter interpreter(delegate, mode);
+        StatementParser parser(file.text(), interpreter.symbols());
+        size_t index = 0;
+        while (auto prog = parser.next()) {
+            ++index;
+            auto* stmt = csp::dyncast<ExprStatement const*>(
+                *prog->statements().begin());
+            if (!stmt) {
+                interpreter.runOnce(*prog);
+                continue;
+            }
+            auto const base = interpreter.variables();
+            std::vector<uint32_t> slots;
+            std::vector<std::vector<double>> columns;
+            BatchEvaluator batch;
+            for (uint32_t slot = 0; slot < base.values.size(); ++slot) {
+                if (!base.declared[slot]) {
+                    continue;
+                }
+                auto& column = columns.emplace_back(numRows);
+                for (size_t row = 0; row < numRows; ++row) {
+                    column[row] = base.values[slot] + double(row);
+                }
+                slots.push_back(slot);
+                batch.bind(slot, column);
+            }
+            std::vector<double> results(numRows);
+            auto start = Clock::now();
+            batch.eval(*stmt->expr(), results);
+            auto batchTime = Clock::now() - start;
+            start = Clock::now();
+            size_t numMismatches = 0;
+            try {
+                for (size_t row = 0; row < numRows; ++row) {
+                    for (size_t i = 0; i < slots.size(); ++i) {
+                        interpreter.assign(slots[i], columns[i][row]);
+                    }
+                    interpreter.run(*prog);
+                    if (!sameResult(results[row], delegate.value) &&
+                        numMismatches++ == 0)
+                    {
+                        printf("Statement %zu, row %zu: batch %.17g, scalar "
+                               "%.17g\n",
+                               index, row, results[row], delegate.value);
+                    }
+                }
+            }
+            catch (...) {
+                interpreter.forget(*prog);
+                throw;
+            }
+            interpreter.forget(*prog);
+            auto scalarTime = Clock::now() - start;
+            for (uint32_t slot : slots) {
+                interpreter.assign(slot, base.values[slot]);
+            }
+            printf("Statement %zu: %zu rows, %zu mismatches, batch %.3f ms, "
+                   "scalar %.3f ms\n",
+                   index, numRows, numMismatches, toMilliseconds(batchTime),
+                   toMilliseconds(scalarTime));
+            if (numMismatches > 0) {
+                return 1;
+            }
+        }
+    }
+    catch (QuitException const&) {
+    }
+    catch (std::runtime_error const& e) {
+        printError(e.what());
+        return 1;
+    }
+    return 0;
+}
+
+int examples::checkFlat(std::string const& path, InterpreterMode mode) {
+    RecordingDelegate expected, actual;
+    Interpreter interpreter(expected, mode);
+    Variables variables;
+    size_t index = 0;
+    try {
+        MappedFile file(path);
+        StatementParser parser(file.text(), interpreter.symbols());
+        while (auto prog = parser.next()) {
+            ++index;
+            FlatAST tree = flatten(*prog);
+            interpreter.runOnce(*prog);
+            variables.reserveSlots(prog->numSlots());
+            execute(tree, actual, variables);
+            if (actual.values != expected.values) {
+                printf("Statement %zu: flat AST result differs\n", index);
+                return 1;
+            }
+        }
+    }
+    catch (QuitException const&) {
+    }
+    catch (std::runtime_error const& e) {
+        printf("Statement %zu: %s\n", index, e.what());
+        return 1;
+    }
+    printf("%zu statements match the flat AST\n", index);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef CHECKS_HPP
+#define CHECKS_HPP
+
+/// This file defines drivers that run a script through the evaluation cache,
+/// the batch evaluator and the flat AST and check their results against the
+/// interpreter. All of them return the exit code of the program
+
+#include <cstddef>
+#include <string>
+
+#include "interpreter.hpp"
+
+namespace examples {
+
+/// Parses the script at \p path once and runs it \p repeat times with the
+/// same interpreter. In tree-walk mode the runs after the first one reuse the
+/// cached values of all expressions that do not read a changed variable.
+/// Prints the cache statistics of each run to `stderr`
+int repeatScript(std::string const& path, Interpreter& interpreter,
+                 InterpreterMode mode, bool optimizeInput, size_t repeat);
+
+/// Runs the script at \p path statement by statement. Every expression
+/// statement is evaluated by `BatchEvaluator` for \p numRows rows, where row
+/// `r` assigns every declared variable its current value plus `r`. The result
+/// of each row is checked against the scalar interpreter
+int checkBatch(std::string const& path, InterpreterMode mode, size_t numRows);
+
+/// Runs the script at \p path statement by statement with the interpreter and
+/// through a `FlatAST` of every statement and checks that both produce the
+/// same values
+int checkFlat(std::string const& path, InterpreterMode mode);
+
+} // namespace examples
+
+#endif // CHECKS_HPP
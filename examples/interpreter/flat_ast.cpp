@@ -0,0 +1,153 @@
+#include "flat_ast.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+using namespace examples;
+using namespace csp;
+
+FlatAST examples::flatten(Program const& program) {
+    FlatAST result;
+    auto push = [](auto& payloads, auto value) {
+        payloads.push_back(value);
+        return uint32_t(payloads.size() - 1);
+    };
+    /// Breadth-first order: `order` doubles as the queue of nodes to visit
+    std::vector<ASTNode const*> order = { &program };
+    for (size_t index = 0; index < order.size(); ++index) {
+        ASTNode const& node = *order[index];
+        result.m_kinds.push_back(get_rtti(node));
+        result.m_childOffsets.push_back((uint32_t)order.size());
+        auto children = node.children();
+        order.insert(order.end(), children.begin(), children.end());
+        // clang-format off
+        uint32_t payload = visit(node, overload{
+            [&](Identifier const& ID) {
+                uint32_t offset = (uint32_t)result.m_names.size();
+                result.m_names += ID.value();
+                return push(result.m_identifiers,
+                            FlatAST::IdentifierData{
+                                offset, (uint32_t)ID.value().size(),
+                                ID.slot() });
+            },
+            [&](Literal const& lit) {
+                return push(result.m_literals, lit.value());
+            },
+            [&](BinaryExpr const& expr) {
+                return push(result.m_binaryOperators, expr.getOperator());
+            },
+            [&](UnaryExpr const& expr) {
+                return push(result.m_unaryOperators, expr.getOperator());
+            },
+            [&](CallExpr const& call) {
+                return push(result.m_builtins,
+                            uint32_t(call.builtin() - builtins().data()));
+            },
+            [&](InstrStatement const& stmt) {
+                return push(result.m_instructions, stmt.instruction());
+            },
+            [](ASTNode const&) { return uint32_t(0); },
+        }); // clang-format on
+        result.m_payloads.push_back(payload);
+    }
+    result.m_childOffsets.push_back((uint32_t)order.size());
+    return result;
+}
+
+namespace {
+
+/// Evaluates the statements of a `FlatAST` the same way the tree-walk
+/// interpreter evaluates the pointer-based AST
+struct FlatEvaluator {
+    InterpreterDelegate& delegate;
+    Variables& variables;
+
+    void run(FlatProgram const& prog) {
+        for (auto stmt : prog.statements()) {
+            stmt.visit([&](auto const& stmt) { interpret(stmt); });
+        }
+    }
+
+    void interpret(FlatEmptyStatement const&) {}
+
+    void interpret(FlatVarDecl const& decl) {
+        double value = eval(decl.initExpr());
+        uint32_t slot = decl.name().slot();
+        variables.declared[slot] = true;
+        variables.values[slot] = value;
+    }
+
+    void interpret(FlatInstrStatement const& stmt) {
+        using enum InstrStatement::Instruction;
+        switch (stmt.instruction()) {
+        case Print: {
+            for (auto arg : stmt.operands()) {
+                delegate.print(eval(arg));
+            }
+            break;
+        }
+        case Quit: delegate.quit(); break;
+        }
+    }
+
+    void interpret(FlatExprStatement const& stmt) {
+        delegate.eval(eval(stmt.expr()));
+    }
+
+    double eval(dyn_union<FlatExpr> const& expr) {
+        return expr.visit([&](auto const& expr) { return doEval(expr); });
+    }
+
+    double doEval(FlatIdentifier const& ID) {
+        if (!variables.declared[ID.slot()]) {
+            throw std::runtime_error("Use of undeclared identifier: " +
+                                     std::string(ID.value()));
+        }
+        return variables.values[ID.slot()];
+    }
+
+    double doEval(FlatLiteral const& lit) { return lit.value(); }
+
+    double doEval(FlatBinaryExpr const& expr) {
+        double lhs = eval(expr.lhs());
+        double rhs = eval(expr.rhs());
+        switch (expr.getOperator()) {
+            using enum BinaryExpr::Operator;
+        case Add: return lhs + rhs;
+        case Sub: return lhs - rhs;
+        case Mul: return lhs * rhs;
+        case Div: return lhs / rhs;
+        case Pow: return std::pow(lhs, rhs);
+        }
+        assert(false && "Invalid operator");
+        return 0;
+    }
+
+    double doEval(FlatUnaryExpr const& expr) {
+        double operand = eval(expr.operand());
+        switch (expr.getOperator()) {
+            using enum UnaryExpr::Operator;
+        case Promote: return operand;
+        case Negate: return -operand;
+        }
+        assert(false && "Invalid operator");
+        return 0;
+    }
+
+    double doEval(FlatCallExpr const& call) {
+        double values[MaxBuiltinArity];
+        size_t index = 0;
+        for (auto arg : call.arguments()) {
+            values[index++] = eval(arg);
+        }
+        return call.builtin().function(values);
+    }
+};
+
+} // namespace
+
+void examples::execute(FlatAST const& tree, InterpreterDelegate& delegate,
+                       Variables& variables) {
+    FlatEvaluator{ delegate, variables }.run(tree.root());
+}
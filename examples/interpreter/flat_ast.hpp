@@ -0,0 +1,351 @@
+#ifndef FLAT_AST_HPP
+#define FLAT_AST_HPP
+
+/// This file defines a flat, struct-of-arrays representation of the AST.
+/// Nodes are identified by their index into the columns of a `FlatAST`, and
+/// handle types that mirror the node classes give access to them. The handle
+/// types form a class hierarchy of their own whose runtime type is read from
+/// the kind column, so `csp::isa`, `csp::dyncast` and `csp::visit` work on
+/// them like on the pointer-based AST.
+
+#include <cstdint>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+#include <vector>
+
+#include "ast.hpp"
+#include "builtins.hpp"
+#include "interpreter.hpp"
+
+namespace examples {
+
+class FlatAST;
+
+#define X(Name, ...) class Flat##Name;
+AST_LIST(X)
+#undef X
+
+enum class FlatNodeID {
+#define X(Name, ...) Name,
+    AST_LIST(X)
+#undef X
+};
+
+using FlatNoParent = void;
+
+} // namespace examples
+
+#define X(Name, Parent, Corporeality)                                          \
+    CSP_DEFINE(examples::Flat##Name, examples::FlatNodeID::Name,               \
+               examples::Flat##Parent, Corporeality)
+AST_LIST(X)
+#undef X
+
+namespace examples {
+
+/// Struct-of-arrays representation of a program. Nodes are numbered in
+/// breadth-first order, so the children of every node are a contiguous range
+/// of indices and children have larger indices than their parents. The root
+/// is node 0. All columns are arrays of trivially copyable values, so trees
+/// can be copied and serialized as plain memory.
+class FlatAST {
+public:
+    /// \Returns the number of nodes
+    size_t size() const { return m_kinds.size(); }
+
+    /// \Returns the kind of node \p index
+    ASTNodeID kind(uint32_t index) const { return m_kinds[index]; }
+
+    /// \Returns the index of the first child of node \p index
+    uint32_t firstChild(uint32_t index) const { return m_childOffsets[index]; }
+
+    /// \Returns the number of children of node \p index
+    uint32_t numChildren(uint32_t index) const {
+        return m_childOffsets[index + 1] - m_childOffsets[index];
+    }
+
+    /// \Returns a handle to node \p index as a union of the concrete handle
+    /// types derived from \p Base. Throws `std::bad_cast` if the node is not
+    /// derived from \p Base
+    template <typename Base = FlatASTNode>
+    csp::dyn_union<Base> node(uint32_t index) const;
+
+    /// \Returns a handle to the root
+    FlatProgram root() const;
+
+private:
+#define X(Name, ...) friend class Flat##Name;
+    AST_LIST(X)
+#undef X
+
+    friend FlatAST flatten(Program const& program);
+
+    struct IdentifierData {
+        uint32_t nameOffset;
+        uint32_t nameSize;
+        uint32_t slot;
+    };
+
+    /// Columns with one entry per node
+    std::vector<ASTNodeID> m_kinds;
+    std::vector<uint32_t> m_childOffsets;
+    std::vector<uint32_t> m_payloads;
+
+    /// Payload arrays per node kind, indexed by `m_payloads`
+    std::vector<IdentifierData> m_identifiers;
+    std::string m_names;
+    std::vector<double> m_literals;
+    std::vector<BinaryExpr::Operator> m_binaryOperators;
+    std::vector<UnaryExpr::Operator> m_unaryOperators;
+    std::vector<uint32_t> m_builtins;
+    std::vector<InstrStatement::Instruction> m_instructions;
+};
+
+/// Converts \p program to its flat representation
+FlatAST flatten(Program const& program);
+
+/// Runs the program in \p tree by walking its columns. \p variables must have
+/// room for all slots used by \p tree
+void execute(FlatAST const& tree, InterpreterDelegate& delegate,
+             Variables& variables);
+
+/// Handle to a node of a `FlatAST`. Handles are cheap to copy and stay valid
+/// as long as the tree.
+class FlatASTNode {
+public:
+    FlatAST const& tree() const { return *m_tree; }
+
+    uint32_t index() const { return m_index; }
+
+    size_t numChildren() const { return m_tree->numChildren(m_index); }
+
+    template <typename T = FlatASTNode>
+    csp::dyn_union<T> childAt(size_t index) const {
+        assert(index < numChildren());
+        return m_tree->node<T>(m_tree->firstChild(m_index) + (uint32_t)index);
+    }
+
+    /// \Returns a range of handles to the children
+    template <typename T = FlatASTNode>
+    auto children() const {
+        uint32_t first = m_tree->firstChild(m_index);
+        return std::views::iota(first, first + (uint32_t)numChildren()) |
+               std::views::transform([tree = m_tree](uint32_t index) {
+            return tree->node<T>(index);
+        });
+    }
+
+protected:
+    FlatASTNode(FlatAST const* tree, uint32_t index):
+        m_tree(tree), m_index(index) {}
+
+    uint32_t payload() const { return m_tree->m_payloads[m_index]; }
+
+private:
+    friend FlatNodeID get_rtti(FlatASTNode const& node) {
+        return FlatNodeID(node.m_tree->kind(node.m_index));
+    }
+
+    FlatAST const* m_tree;
+    uint32_t m_index;
+};
+
+class FlatExpr: public FlatASTNode {
+protected:
+    using FlatASTNode::FlatASTNode;
+};
+
+class FlatIdentifier: public FlatExpr {
+public:
+    std::string_view value() const {
+        auto& data = tree().m_identifiers[payload()];
+        return std::string_view(tree().m_names)
+            .substr(data.nameOffset, data.nameSize);
+    }
+
+    uint32_t slot() const { return tree().m_identifiers[payload()].slot; }
+
+private:
+    friend class FlatAST;
+    using FlatExpr::FlatExpr;
+};
+
+class FlatLiteral: public FlatExpr {
+public:
+    double value() const { return tree().m_literals[payload()]; }
+
+private:
+    friend class FlatAST;
+    using FlatExpr::FlatExpr;
+};
+
+class FlatBinaryExpr: public FlatExpr {
+public:
+    BinaryExpr::Operator getOperator() const {
+        return tree().m_binaryOperators[payload()];
+    }
+
+    csp::dyn_union<FlatExpr> lhs() const;
+
+    csp::dyn_union<FlatExpr> rhs() const;
+
+private:
+    friend class FlatAST;
+    using FlatExpr::FlatExpr;
+};
+
+class FlatUnaryExpr: public FlatExpr {
+public:
+    UnaryExpr::Operator getOperator() const {
+        return tree().m_unaryOperators[payload()];
+    }
+
+    csp::dyn_union<FlatExpr> operand() const;
+
+private:
+    friend class FlatAST;
+    using FlatExpr::FlatExpr;
+};
+
+class FlatCallExpr: public FlatExpr {
+public:
+    Builtin const& builtin() const {
+        return builtins()[tree().m_builtins[payload()]];
+    }
+
+    csp::dyn_union<FlatExpr> callee() const;
+
+    auto arguments() const;
+
+private:
+    friend class FlatAST;
+    using FlatExpr::FlatExpr;
+};
+
+class FlatStatement: public FlatASTNode {
+protected:
+    using FlatASTNode::FlatASTNode;
+};
+
+class FlatEmptyStatement: public FlatStatement {
+private:
+    friend class FlatAST;
+    using FlatStatement::FlatStatement;
+};
+
+class FlatVarDecl: public FlatStatement {
+public:
+    FlatIdentifier name() const;
+
+    csp::dyn_union<FlatExpr> initExpr() const;
+
+private:
+    friend class FlatAST;
+    using FlatStatement::FlatStatement;
+};
+
+class FlatInstrStatement: public FlatStatement {
+public:
+    InstrStatement::Instruction instruction() const {
+        return tree().m_instructions[payload()];
+    }
+
+    auto operands() const;
+
+private:
+    friend class FlatAST;
+    using FlatStatement::FlatStatement;
+};
+
+class FlatExprStatement: public FlatStatement {
+public:
+    csp::dyn_union<FlatExpr> expr() const;
+
+private:
+    friend class FlatAST;
+    using FlatStatement::FlatStatement;
+};
+
+class FlatProgram: public FlatASTNode {
+public:
+    auto statements() const;
+
+private:
+    friend class FlatAST;
+    using FlatASTNode::FlatASTNode;
+};
+
+/// Names the corporeality arguments of `AST_LIST`
+enum class FlatCorporeality { Abstract, Concrete };
+
+template <typename Base>
+csp::dyn_union<Base> FlatAST::node(uint32_t index) const {
+    switch (m_kinds[index]) {
+#define X(Name, Parent, Corp)                                                  \
+    case ASTNodeID::Name:                                                      \
+        if constexpr (FlatCorporeality::Corp ==                                \
+                          FlatCorporeality::Concrete &&                        \
+                      std::derived_from<Flat##Name, Base>)                     \
+        {                                                                      \
+            return Flat##Name(this, index);                                    \
+        }                                                                      \
+        break;
+        AST_LIST(X)
+#undef X
+    }
+    throw std::bad_cast();
+}
+
+/// Accessors that return unions of handles are defined here because the union
+/// types require all handle types to be complete
+
+inline csp::dyn_union<FlatExpr> FlatBinaryExpr::lhs() const {
+    return childAt<FlatExpr>(0);
+}
+
+inline csp::dyn_union<FlatExpr> FlatBinaryExpr::rhs() const {
+    return childAt<FlatExpr>(1);
+}
+
+inline csp::dyn_union<FlatExpr> FlatUnaryExpr::operand() const {
+    return childAt<FlatExpr>(0);
+}
+
+inline csp::dyn_union<FlatExpr> FlatCallExpr::callee() const {
+    return childAt<FlatExpr>(0);
+}
+
+inline auto FlatCallExpr::arguments() const {
+    return children<FlatExpr>() | std::views::drop(1);
+}
+
+inline FlatIdentifier FlatVarDecl::name() const {
+    return childAt<FlatIdentifier>(0).get<FlatIdentifier>();
+}
+
+inline csp::dyn_union<FlatExpr> FlatVarDecl::initExpr() const {
+    return childAt<FlatExpr>(1);
+}
+
+inline auto FlatInstrStatement::operands() const {
+    return children<FlatExpr>();
+}
+
+inline csp::dyn_union<FlatExpr> FlatExprStatement::expr() const {
+    return childAt<FlatExpr>(0);
+}
+
+inline auto FlatProgram::statements() const {
+    return children<FlatStatement>();
+}
+
+inline FlatProgram FlatAST::root() const {
+    assert(!m_kinds.empty() && m_kinds[0] == ASTNodeID::Program);
+    return FlatProgram(this, 0);
+}
+
+} // namespace examples
+
+#endif // FLAT_AST_HPP
@@ -1,17 +1,38 @@
 #include "interpreter.hpp"
 
+#include <algorithm>
 #include <cmath>
-#include <map>
 #include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "csp/memo.hpp"
+#include "csp/traverse.hpp"
+
+#include "builtins.hpp"
+#include "bytecode.hpp"
 
 using namespace examples;
 using namespace csp;
 
 struct Interpreter::Impl {
 public:
-    Impl(InterpreterDelegate& delegate): delegate(delegate) {}
+    Impl(InterpreterDelegate& delegate, InterpreterMode mode):
+        delegate(delegate), mode(mode) {}
 
     void run(Program const& prog) {
+        variables.reserveSlots(prog.numSlots());
+        if (mode == InterpreterMode::Bytecode) {
+            auto itr = compiled.find(&prog);
+            if (itr == compiled.end()) {
+                itr = compiled.insert({ &prog, compile(prog) }).first;
+            }
+            execute(itr->second, delegate, variables);
+            return;
+        }
+        if (uses.size() < prog.numSlots()) {
+            uses.resize(prog.numSlots());
+        }
         for (auto* stmt : prog.statements()) {
             interpret(*stmt);
         }
@@ -24,7 +45,27 @@ public:
     void doInterpret(EmptyStatement const&) {}
 
     void doInterpret(VarDecl const& decl) {
-        IDMap[decl.name()->value()] = eval(*decl.initExpr());
+        assign(decl.name()->slot(), eval(*decl.initExpr()));
+    }
+
+    void assign(uint32_t slot, double value) {
+        variables.reserveSlots(slot + 1);
+        if (uses.size() <= slot) {
+            uses.resize(slot + 1);
+        }
+        if (!variables.declared[slot]) {
+            variables.declared[slot] = true;
+            variables.values[slot] = value;
+            return;
+        }
+        if (variables.values[slot] == value) {
+            return;
+        }
+        variables.values[slot] = value;
+        /// Cached results that read the old value are stale now
+        for (auto* use : uses[slot]) {
+            evalCache.mark_dirty(*use);
+        }
     }
 
     void doInterpret(InstrStatement const& stmt) {
@@ -46,16 +87,16 @@ public:
     }
 
     double eval(Expr const& expr) {
-        return visit(expr, [&](auto& expr) { return doEval(expr); });
+        return evalCache.visit(expr, [&](auto& expr) { return doEval(expr); });
     }
 
     double doEval(Identifier const& ID) {
-        auto itr = IDMap.find(ID.value());
-        if (itr == IDMap.end()) {
+        uses[ID.slot()].insert(&ID);
+        if (!variables.declared[ID.slot()]) {
             throw std::runtime_error("Use of undeclared identifier: " +
-                                     ID.value());
+                                     std::string(ID.value()));
         }
-        return itr->second;
+        return variables.values[ID.slot()];
     }
 
     double doEval(Literal const& lit) { return lit.value(); }
@@ -82,46 +123,95 @@ public:
         }
     }
 
-    template <int N>
-    double callImpl(CallExpr const& call, std::string_view functionName,
-                    auto fn) {
-        if (call.arguments().size() != N) {
-            throw std::runtime_error("Invalid number of arguments");
+    double doEval(CallExpr const& call) {
+        auto args = call.argumentSpan();
+        double values[MaxBuiltinArity];
+        for (size_t i = 0; i < args.size(); ++i) {
+            values[i] = eval(*cast<Expr const*>(args[i]));
         }
-        return [&]<size_t... I>(std::index_sequence<I...>) {
-            return fn(eval(*call.arguments()[I])...);
-        }(std::make_index_sequence<(size_t)N>{});
+        return call.builtin()->function(values);
     }
 
-    double doEval(CallExpr const& expr) {
-        auto* ID = dyncast<Identifier const*>(expr.callee());
-        if (!ID) {
-            throw std::runtime_error("Cannot call expression");
+    void reset() {
+        std::fill(variables.declared.begin(), variables.declared.end(), 0);
+        for (auto& slotUses : uses) {
+            for (auto* use : slotUses) {
+                evalCache.mark_dirty(*use);
+            }
         }
-#define IMPL(name, numArgs, nativeName)                                        \
-    if (ID->value() == name) {                                                 \
-        return callImpl<numArgs>(expr, ID->value(), [](auto... args) {         \
-            return nativeName(args...);                                        \
-        });                                                                    \
     }
-        IMPL("sqrt", 1, std::sqrt);
-        IMPL("pow", 2, std::pow);
-        IMPL("exp", 1, std::exp);
-        IMPL("exp2", 1, std::exp2);
-        IMPL("log", 1, std::log);
-        IMPL("log2", 1, std::log2);
-        throw std::runtime_error("Use of unknown function: " + ID->value());
+
+    void forget(Program const& prog) {
+        compiled.erase(&prog);
+        auto children = [](ASTNode const& node) { return node.children(); };
+        // clang-format off
+        traverse(prog, children, overload{
+            [&](Identifier const& ID) {
+                if (ID.slot() < uses.size()) {
+                    uses[ID.slot()].erase(&ID);
+                }
+                evalCache.forget(ID);
+            },
+            [&](Expr const& expr) { evalCache.forget(expr); },
+            [&](ASTNode const&) {},
+        }); // clang-format on
     }
 
     InterpreterDelegate& delegate;
-    std::map<std::string, double> IDMap;
+    InterpreterMode mode;
+    SymbolTable symbols;
+    Variables variables;
+
+    /// Bytecode of the programs that ran in bytecode mode
+    std::unordered_map<Program const*, Bytecode> compiled;
+
+    /// Results of `eval()` are cached until a variable they read changes
+    memo_visitor<Expr const, double> evalCache;
+
+    /// Maps variable slots to the identifiers that read them
+    std::vector<std::unordered_set<Identifier const*>> uses;
 };
 
-Interpreter::Interpreter(InterpreterDelegate& delegate):
-    impl(std::make_unique<Impl>(delegate)) {}
+Interpreter::Interpreter(InterpreterDelegate& delegate, InterpreterMode mode):
+    impl(std::make_unique<Impl>(delegate, mode)) {}
 
 Interpreter::~Interpreter() = default;
 
 void Interpreter::run(Program const& program) {
     impl->run(program);
 }
+
+void Interpreter::runOnce(Program const& program) {
+    /// Drop the cached results of `program` before it is destroyed
+    struct ForgetGuard {
+        Impl& impl;
+        Program const& prog;
+        ~ForgetGuard() { impl.forget(prog); }
+    } guard{ *impl, program };
+    impl->run(program);
+}
+
+SymbolTable& Interpreter::symbols() {
+    return impl->symbols;
+}
+
+void Interpreter::reset() {
+    impl->reset();
+}
+
+void Interpreter::forget(Program const& program) {
+    impl->forget(program);
+}
+
+Variables const& Interpreter::variables() const {
+    return impl->variables;
+}
+
+void Interpreter::assign(uint32_t slot, double value) {
+    impl->assign(slot, value);
+}
+
+EvalCacheStatistics Interpreter::evalCacheStatistics() const {
+    auto const& stats = impl->evalCache.stats();
+    return { stats.hits, stats.misses };
+}
@@ -1,7 +1,9 @@
 #ifndef INTERPRETER_HPP
 #define INTERPRETER_HPP
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "ast.hpp"
 
@@ -16,14 +18,75 @@ public:
     virtual void quit() = 0;
 };
 
+/// Values of the variables, indexed by the slots of a `SymbolTable`
+struct Variables {
+    std::vector<double> values;
+    std::vector<uint8_t> declared;
+
+    /// Makes room for at least \p numSlots slots
+    void reserveSlots(size_t numSlots) {
+        if (numSlots > values.size()) {
+            values.resize(numSlots);
+            declared.resize(numSlots);
+        }
+    }
+};
+
+/// Selects how the interpreter executes programs
+enum class InterpreterMode {
+    /// Programs are compiled to bytecode once and executed by a stack machine
+    Bytecode,
+
+    /// Programs are evaluated by walking the AST. This is the reference
+    /// implementation
+    TreeWalk
+};
+
+/// Counts how often the tree-walk interpreter found the value of an
+/// expression in its cache and how often it had to evaluate the expression
+struct EvalCacheStatistics {
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
 class Interpreter {
 public:
-    explicit Interpreter(InterpreterDelegate& delegate);
+    explicit Interpreter(InterpreterDelegate& delegate,
+                         InterpreterMode mode = InterpreterMode::Bytecode);
 
     ~Interpreter();
 
+    /// Runs \p program, which must be parsed with `symbols()`. Only the
+    /// thread that parses may access `symbols()` while programs run, so
+    /// parsing and running can happen on different threads
     void run(Program const& program);
 
+    /// Runs \p program and forgets it afterwards, also if running throws. For
+    /// programs that are destroyed after they ran once
+    void runOnce(Program const& program);
+
+    /// The symbol table that assigns the slots of the variables
+    SymbolTable& symbols();
+
+    /// Undeclares all variables, so the next program runs as if it was the
+    /// first one
+    void reset();
+
+    /// In tree-walk mode evaluation results are cached per AST node, so
+    /// running a program again only evaluates expressions that read changed
+    /// variables. In bytecode mode the compiled program is cached. This must
+    /// be called before \p program is destroyed.
+    void forget(Program const& program);
+
+    /// The values of the variables. Must not be accessed while a program runs
+    Variables const& variables() const;
+
+    /// Declares the variable in \p slot with \p value like a `let` statement
+    void assign(uint32_t slot, double value);
+
+    /// Cache statistics of all programs that ran in tree-walk mode
+    EvalCacheStatistics evalCacheStatistics() const;
+
 private:
     struct Impl;
     std::unique_ptr<Impl> impl;
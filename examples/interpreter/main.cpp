@@ -1,8 +1,22 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "ast.hpp"
+#include "checks.hpp"
 #include "interpreter.hpp"
+#include "mapped_file.hpp"
+#include "optimizer.hpp"
 #include "parser.hpp"
+#include "script.hpp"
+#include "script_pool.hpp"
 #include "terminal.hpp"
 #include "utils.hpp"
 
@@ -10,23 +24,34 @@ using namespace examples;
 
 namespace {
 
+/// Prints the number of nodes that `optimize()` eliminated
+void reportEliminated(size_t count) {
+    if (count == 0) {
+        return;
+    }
+    format(Format::Grey);
+    printf("Optimizer eliminated %zu node%s\n", count, count == 1 ? "" : "s");
+    format(Format::Reset);
+}
+
 struct TermDelegateImpl: TerminalDelegate {
     Interpreter& interpreter;
+    bool optimizeInput;
 
-    explicit TermDelegateImpl(Interpreter& interpreter):
-        interpreter(interpreter) {}
+    explicit TermDelegateImpl(Interpreter& interpreter, bool optimizeInput):
+        interpreter(interpreter), optimizeInput(optimizeInput) {}
 
     void onInput(std::string input) override {
         input += ";";
         try {
-            auto prog = parse(input);
-            interpreter.run(*prog);
+            auto prog = parse(input, interpreter.symbols());
+            if (optimizeInput) {
+                reportEliminated(optimize(*prog));
+            }
+            interpreter.runOnce(*prog);
         }
         catch (std::runtime_error const& e) {
-            format(Format::Red, Format::Bold);
-            printf("Error: ");
-            format(Format::Reset);
-            printf("%s\n", e.what());
+            printError(e.what());
         }
     }
 
@@ -52,11 +77,171 @@ struct InterpreterDelegateImpl: InterpreterDelegate {
     void quit() override { throw QuitException(); }
 };
 
+/// Runs the script at \p path and returns the exit code
+int runFile(std::string const& path, Interpreter& interpreter,
+            bool optimizeInput) {
+    try {
+        MappedFile file(path);
+        auto stats =
+            runScript(file.text(), interpreter, { .optimize = optimizeInput });
+        if (optimizeInput) {
+            reportEliminated(stats.eliminatedNodes);
+        }
+    }
+    catch (QuitException const&) {
+    }
+    catch (std::runtime_error const& e) {
+        printError(e.what());
+        return 1;
+    }
+    return 0;
+}
+
+/// Replaces directories in \p paths by the regular files they contain
+std::vector<std::string> expandDirectories(std::vector<std::string> paths) {
+    std::vector<std::string> result;
+    for (auto& path : paths) {
+        if (!std::filesystem::is_directory(path)) {
+            result.push_back(std::move(path));
+            continue;
+        }
+        size_t first = result.size();
+        for (auto& entry : std::filesystem::directory_iterator(path)) {
+            if (entry.is_regular_file()) {
+                result.push_back(entry.path().string());
+            }
+        }
+        std::sort(result.begin() + first, result.end());
+    }
+    return result;
+}
+
+/// Prints throughput and latency percentiles of \p results to `stderr`
+void reportStatistics(std::span<ScriptResult const> results,
+                      std::chrono::nanoseconds wallTime, size_t numThreads) {
+    std::vector<std::chrono::nanoseconds> latencies;
+    size_t numFailed = 0;
+    for (auto& result : results) {
+        latencies.push_back(result.latency);
+        numFailed += !result.success;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        size_t index = (size_t)(p / 100 * double(latencies.size() - 1));
+        return toMilliseconds(latencies[index]);
+    };
+    double seconds = toMilliseconds(wallTime) / 1000;
+    fprintf(stderr, "%zu scripts (%zu failed) on %zu threads in %.3f s, "
+                    "%.1f scripts/s\n",
+            results.size(), numFailed, numThreads, seconds,
+            double(results.size()) / seconds);
+    if (!latencies.empty()) {
+        fprintf(stderr, "Latency [ms]: p50 %.3f, p90 %.3f, p99 %.3f, "
+                        "max %.3f\n",
+                percentile(50), percentile(90), percentile(99),
+                toMilliseconds(latencies.back()));
+    }
+}
+
+/// Runs the scripts at \p paths in parallel, prints their output in order
+/// and returns the exit code
+int runFiles(std::vector<std::string> const& paths,
+             ScriptPoolOptions const& options) {
+    auto start = std::chrono::steady_clock::now();
+    auto results = runScripts(paths, options);
+    auto wallTime = std::chrono::steady_clock::now() - start;
+    bool success = true;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        printf("==> %s <==\n%s", paths[i].c_str(), results[i].output.c_str());
+        success &= results[i].success;
+    }
+    fflush(stdout);
+    reportStatistics(results, wallTime,
+                     std::min(options.numThreads, results.size()));
+    return success ? 0 : 1;
+}
+
 } // namespace
 
-int main() {
+int main(int argc, char** argv) {
+    InterpreterMode mode = InterpreterMode::Bytecode;
+    std::vector<std::string> scriptPaths;
+    bool optimizeInput = false;
+    size_t numThreads = 0;
+    size_t repeat = 1;
+    size_t batchRows = 0;
+    bool checkFlatAST = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--tree-walk") == 0) {
+            mode = InterpreterMode::TreeWalk;
+        }
+        else if (std::strcmp(argv[i], "--bytecode") == 0) {
+            mode = InterpreterMode::Bytecode;
+        }
+        else if (std::strcmp(argv[i], "--optimize") == 0) {
+            optimizeInput = true;
+        }
+        else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc &&
+                 std::atoi(argv[i + 1]) > 0)
+        {
+            numThreads = (size_t)std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc &&
+                 std::atoi(argv[i + 1]) > 0)
+        {
+            repeat = (size_t)std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc &&
+                 std::atoi(argv[i + 1]) > 0)
+        {
+            batchRows = (size_t)std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--check-flat") == 0) {
+            checkFlatAST = true;
+        }
+        else if (argv[i][0] != '-') {
+            scriptPaths.push_back(argv[i]);
+        }
+        else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--tree-walk|--bytecode] [--optimize] [--jobs N]"
+                         " [--repeat N] [--batch ROWS] [--check-flat]"
+                         " [script|directory]..."
+                      << std::endl;
+            return 1;
+        }
+    }
+    /// A single script runs with the pipelined parser, multiple scripts run in
+    /// parallel
+    bool single = scriptPaths.size() == 1 && numThreads == 0 &&
+                  !std::filesystem::is_directory(scriptPaths.front());
+    if (!scriptPaths.empty() && !single) {
+        ScriptPoolOptions options;
+        options.numThreads = numThreads;
+        if (numThreads == 0) {
+            options.numThreads = std::max(std::thread::hardware_concurrency(),
+                                          1u);
+        }
+        options.mode = mode;
+        options.optimize = optimizeInput;
+        return runFiles(expandDirectories(std::move(scriptPaths)), options);
+    }
+    /// The checks construct their own interpreters with recording delegates
+    if (single && checkFlatAST) {
+        return checkFlat(scriptPaths.front(), mode);
+    }
+    if (single && batchRows > 0) {
+        return checkBatch(scriptPaths.front(), mode, batchRows);
+    }
     InterpreterDelegateImpl interpreterDelegate;
-    Interpreter interpreter(interpreterDelegate);
-    TermDelegateImpl termDelegate(interpreter);
+    Interpreter interpreter(interpreterDelegate, mode);
+    if (single && repeat > 1) {
+        return repeatScript(scriptPaths.front(), interpreter, mode,
+                            optimizeInput, repeat);
+    }
+    if (single) {
+        return runFile(scriptPaths.front(), interpreter, optimizeInput);
+    }
+    TermDelegateImpl termDelegate(interpreter, optimizeInput);
     return runTerminal(termDelegate);
 }
@@ -0,0 +1,50 @@
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace examples;
+
+static std::runtime_error mappingError(std::string const& path) {
+    return std::runtime_error("Failed to map " + path + ": " +
+                              std::strerror(errno));
+}
+
+MappedFile::MappedFile(std::string const& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw mappingError(path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        auto error = mappingError(path);
+        ::close(fd);
+        throw error;
+    }
+    m_size = (size_t)info.st_size;
+    /// Empty files cannot be mapped, but they have no text to map either
+    if (m_size > 0) {
+        void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            auto error = mappingError(path);
+            ::close(fd);
+            throw error;
+        }
+        ::madvise(data, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<char const*>(data);
+    }
+    /// The mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace examples {
+
+/// Read-only memory mapping of a file. The pages are loaded by the operating
+/// system as they are read, so large files do not have to fit in memory
+class MappedFile {
+public:
+    /// Maps the file at \p path. Throws `std::runtime_error` on failure
+    explicit MappedFile(std::string const& path);
+
+    MappedFile(MappedFile const&) = delete;
+
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    ~MappedFile();
+
+    /// \Returns the contents of the file
+    std::string_view text() const { return { m_data, m_size }; }
+
+private:
+    char const* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+} // namespace examples
+
+#endif // MAPPED_FILE_HPP
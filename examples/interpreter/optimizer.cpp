@@ -0,0 +1,147 @@
+#include "optimizer.hpp"
+
+#include <cassert>
+#include <cmath>
+
+#include "builtins.hpp"
+
+using namespace examples;
+using namespace csp;
+
+namespace {
+
+size_t countNodes(ASTNode const& node) {
+    size_t count = 1;
+    for (auto* child : node.children()) {
+        count += countNodes(*child);
+    }
+    return count;
+}
+
+double apply(BinaryExpr::Operator op, double lhs, double rhs) {
+    switch (op) {
+        using enum BinaryExpr::Operator;
+    case Add: return lhs + rhs;
+    case Sub: return lhs - rhs;
+    case Mul: return lhs * rhs;
+    case Div: return lhs / rhs;
+    case Pow: return std::pow(lhs, rhs);
+    }
+    assert(false && "Invalid operator");
+    return 0;
+}
+
+bool isLiteral(Expr const* expr, double value) {
+    auto* lit = dyncast<Literal const*>(expr);
+    return lit && lit->value() == value;
+}
+
+class Optimizer {
+public:
+    explicit Optimizer(ASTStorage& storage): storage(storage) {}
+
+    /// Simplifies the expressions in the subtree of \p node
+    void run(ASTNode& node) {
+        for (size_t index = 0; index < node.numChildren(); ++index) {
+            auto* child = node.childAt(index);
+            if (auto* expr = dyncast<Expr*>(child)) {
+                if (auto* simplified = simplify(*expr); simplified != expr) {
+                    node.setChild(index, simplified);
+                }
+            }
+            else {
+                run(*child);
+            }
+        }
+    }
+
+private:
+    /// \Returns \p expr or the node that replaces it
+    Expr* simplify(Expr& expr) {
+        return visit(expr, [&](auto& expr) { return doSimplify(expr); });
+    }
+
+    Expr* doSimplify(Identifier& ID) { return &ID; }
+
+    Expr* doSimplify(Literal& lit) { return &lit; }
+
+    Expr* doSimplify(BinaryExpr& expr) {
+        run(expr);
+        auto* lhs = dyncast<Literal*>(expr.lhs());
+        auto* rhs = dyncast<Literal*>(expr.rhs());
+        if (lhs && rhs) {
+            return makeLiteral(
+                apply(expr.getOperator(), lhs->value(), rhs->value()));
+        }
+        switch (expr.getOperator()) {
+            using enum BinaryExpr::Operator;
+        case Add:
+            if (isLiteral(expr.lhs(), 0)) {
+                return expr.rhs();
+            }
+            [[fallthrough]];
+        case Sub:
+            if (isLiteral(expr.rhs(), 0)) {
+                return expr.lhs();
+            }
+            break;
+        case Mul:
+            if (isLiteral(expr.lhs(), 1)) {
+                return expr.rhs();
+            }
+            [[fallthrough]];
+        case Div:
+        case Pow:
+            if (isLiteral(expr.rhs(), 1)) {
+                return expr.lhs();
+            }
+            break;
+        }
+        return &expr;
+    }
+
+    Expr* doSimplify(UnaryExpr& expr) {
+        run(expr);
+        if (expr.getOperator() == UnaryExpr::Promote) {
+            return expr.operand();
+        }
+        if (auto* lit = dyncast<Literal*>(expr.operand())) {
+            return makeLiteral(-lit->value());
+        }
+        auto* operand = dyncast<UnaryExpr*>(expr.operand());
+        if (operand && operand->getOperator() == UnaryExpr::Negate) {
+            return operand->operand();
+        }
+        return &expr;
+    }
+
+    /// Builtin functions are pure, so calls with constant arguments can be
+    /// evaluated ahead of time
+    Expr* doSimplify(CallExpr& call) {
+        run(call);
+        double args[MaxBuiltinArity];
+        auto argSpan = call.argumentSpan();
+        for (size_t index = 0; index < argSpan.size(); ++index) {
+            auto* lit = dyncast<Literal const*>(argSpan[index]);
+            if (!lit) {
+                return &call;
+            }
+            args[index] = lit->value();
+        }
+        return makeLiteral(call.builtin()->function(args));
+    }
+
+    Literal* makeLiteral(double value) {
+        return storage.make<Literal>(value);
+    }
+
+    ASTStorage& storage;
+};
+
+} // namespace
+
+size_t examples::optimize(Program& program) {
+    size_t before = countNodes(program);
+    Optimizer(program.storage()).run(program);
+    return before - countNodes(program);
+}
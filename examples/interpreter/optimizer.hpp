@@ -0,0 +1,22 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+/// This file defines a pass that simplifies the expressions of a program before
+/// it runs
+
+#include <cstddef>
+
+#include "ast.hpp"
+
+namespace examples {
+
+/// Folds constant subexpressions of \p program, including calls of builtin
+/// functions with constant arguments, and removes the identities `x * 1`,
+/// `x / 1`, `x ^ 1`, `x + 0`, `x - 0`, `+x` and `--x`. Simplified nodes are
+/// replaced in place and new literals are allocated from the storage of
+/// \p program. \Returns the number of nodes that were eliminated
+size_t optimize(Program& program);
+
+} // namespace examples
+
+#endif // OPTIMIZER_HPP
@@ -1,12 +1,23 @@
 #include "parser.hpp"
 
-#include <map>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "csp/traverse.hpp"
+
+#include "builtins.hpp"
 
 using namespace examples;
 
 namespace {
 
-enum class TokenKind {
+enum class TokenKind : uint8_t {
     Let,
     Print,
     Quit,
@@ -30,118 +41,254 @@ struct Token {
     TokenKind kind;
 };
 
-class Lexer {
+/// Character classes as bit flags, so runs of several classes can be scanned
+/// with one mask
+enum CharClass : uint8_t {
+    Space = 1 << 0,
+    Letter = 1 << 1,
+    Digit = 1 << 2,
+    IDBegin = Letter,
+    IDContinue = Letter | Digit,
+};
+
+constexpr std::array<uint8_t, 256> CharClasses = [] {
+    std::array<uint8_t, 256> table{};
+    for (char c : std::string_view(" \t\n\v\f\r")) {
+        table[(uint8_t)c] = Space;
+    }
+    for (int c = 'a'; c <= 'z'; ++c) {
+        table[c] = table[c - 'a' + 'A'] = Letter;
+    }
+    table['_'] = Letter;
+    for (int c = '0'; c <= '9'; ++c) {
+        table[c] = Digit;
+    }
+    return table;
+}();
+
+/// Maps every punctuator to its token kind and all other characters to
+/// `TokenKind::End`
+constexpr std::array<TokenKind, 256> Punctuators = [] {
+    std::array<TokenKind, 256> table;
+    table.fill(TokenKind::End);
+    table['('] = TokenKind::OpenParen;
+    table[')'] = TokenKind::CloseParen;
+    table[';'] = TokenKind::Semicolon;
+    table[','] = TokenKind::Comma;
+    table['='] = TokenKind::Assign;
+    table['+'] = TokenKind::Add;
+    table['-'] = TokenKind::Sub;
+    table['*'] = TokenKind::Mul;
+    table['/'] = TokenKind::Div;
+    table['^'] = TokenKind::Pow;
+    return table;
+}();
+
+struct Keyword {
     std::string_view text;
+    TokenKind kind = TokenKind::Identifier;
+};
 
-    void skipWhitespace() {
-        while (!text.empty() && std::isspace((int)text.front())) {
-            inc();
+constexpr Keyword Keywords[] = {
+    { "let", TokenKind::Let },
+    { "print", TokenKind::Print },
+    { "quit", TokenKind::Quit },
+};
+
+constexpr size_t KeywordTableSize = 8;
+
+constexpr size_t keywordHash(std::string_view ID, uint32_t seed) {
+    return ((uint8_t)ID.front() * seed + ID.size()) % KeywordTableSize;
+}
+
+/// Smallest seed for which `keywordHash` maps all keywords to distinct
+/// entries, found at compile time
+constexpr uint32_t KeywordSeed = [] {
+    for (uint32_t seed = 1;; ++seed) {
+        std::array<bool, KeywordTableSize> used{};
+        bool perfect = true;
+        for (auto& keyword : Keywords) {
+            perfect &= !std::exchange(used[keywordHash(keyword.text, seed)],
+                                      true);
+        }
+        if (perfect) {
+            return seed;
         }
     }
+}();
 
-    void inc() {
-        assert(!text.empty());
-        text = text.substr(1);
+constexpr std::array<Keyword, KeywordTableSize> KeywordTable = [] {
+    std::array<Keyword, KeywordTableSize> table{};
+    for (auto& keyword : Keywords) {
+        table[keywordHash(keyword.text, KeywordSeed)] = keyword;
     }
+    return table;
+}();
 
-    std::string_view getID(char const* begin) const {
-        return std::string_view(begin, std::to_address(text.begin()));
-    }
+/// \Returns the keyword token kind of \p ID or `TokenKind::Identifier`
+TokenKind classifyIdentifier(std::string_view ID) {
+    auto& entry = KeywordTable[keywordHash(ID, KeywordSeed)];
+    return entry.text == ID ? entry.kind : TokenKind::Identifier;
+}
 
-    inline static std::map<std::string_view, TokenKind> const keywords = {
-        { "let", TokenKind::Let },
-        { "print", TokenKind::Print },
-        { "quit", TokenKind::Quit }
-    };
+#if defined(__SSE2__)
 
-public:
-    explicit Lexer(std::string_view text): text(text) {}
+/// \Returns a mask of the bytes of \p chars that are in the range
+/// `[Lo, Hi]`
+template <char Lo, char Hi>
+__m128i inRange(__m128i chars) {
+    __m128i lo = _mm_set1_epi8(Lo), hi = _mm_set1_epi8(Hi);
+    return _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(chars, lo), chars),
+                         _mm_cmpeq_epi8(_mm_min_epu8(chars, hi), chars));
+}
 
-    static bool isIDBegin(char c) { return std::isalpha((int)c) || c == '_'; }
+/// Computes the same classification as `CharClasses` for 16 bytes at once
+template <uint8_t Classes>
+__m128i classify(__m128i chars) {
+    __m128i result = _mm_setzero_si128();
+    if constexpr ((Classes & Space) != 0) {
+        result = _mm_or_si128(result, inRange<'\t', '\r'>(chars));
+        result = _mm_or_si128(result,
+                              _mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')));
+    }
+    if constexpr ((Classes & Letter) != 0) {
+        __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+        result = _mm_or_si128(result, inRange<'a', 'z'>(lower));
+        result = _mm_or_si128(result,
+                              _mm_cmpeq_epi8(chars, _mm_set1_epi8('_')));
+    }
+    if constexpr ((Classes & Digit) != 0) {
+        result = _mm_or_si128(result, inRange<'0', '9'>(chars));
+    }
+    return result;
+}
+
+#endif
+
+/// \Returns a pointer to the first character in `[begin, end)` that is not in
+/// any of \p Classes
+template <uint8_t Classes>
+char const* scan(char const* begin, char const* end) {
+#if defined(__SSE2__)
+    while (end - begin >= 16) {
+        __m128i chars = _mm_loadu_si128((__m128i const*)begin);
+        auto mask = (uint32_t)_mm_movemask_epi8(classify<Classes>(chars));
+        if (mask != 0xFFFF) {
+            return begin + std::countr_one(mask);
+        }
+        begin += 16;
+    }
+#endif
+    while (begin != end && (CharClasses[(uint8_t)*begin] & Classes) != 0) {
+        ++begin;
+    }
+    return begin;
+}
 
-    static bool isID(char c) { return isIDBegin(c) || std::isdigit((int)c); }
+/// Splits the source text into tokens. Tokens are produced in batches into a
+/// contiguous buffer, so the parser only calls into the lexer once per batch
+class Lexer {
+public:
+    explicit Lexer(std::string_view text):
+        pos(text.data()), end(text.data() + text.size()) {}
+
+    /// Replaces the contents of \p tokens by the next at most \p count tokens.
+    /// Once the text is exhausted the buffer ends with a `TokenKind::End` token
+    void tokenize(std::vector<Token>& tokens, size_t count) {
+        tokens.clear();
+        while (tokens.size() < count) {
+            tokens.push_back(next());
+            if (tokens.back().kind == TokenKind::End) {
+                return;
+            }
+        }
+    }
 
     Token next() {
-        skipWhitespace();
-        if (text.empty()) {
+        pos = scan<Space>(pos, end);
+        if (pos == end) {
             return Token{ {}, TokenKind::End };
         }
-        char const* first = &text.front();
-        if (isIDBegin(*first)) {
-            inc();
-            while (!text.empty() && isID(text.front())) {
-                inc();
-            }
-            std::string_view ID = getID(first);
-            if (auto itr = keywords.find(ID); itr != keywords.end()) {
-                return Token{ ID, itr->second };
-            }
-            return Token{ ID, TokenKind::Identifier };
+        char const* first = pos;
+        uint8_t cls = CharClasses[(uint8_t)*first];
+        if (cls & IDBegin) {
+            pos = scan<IDContinue>(first + 1, end);
+            std::string_view ID(first, pos);
+            return Token{ ID, classifyIdentifier(ID) };
         }
-        if ((std::isdigit((int)*first))) {
-            while (!text.empty() && std::isdigit((int)text.front())) {
-                inc();
-            }
-            return Token{ getID(first), TokenKind::NumericLiteral };
+        if (cls & Digit) {
+            pos = scan<Digit>(first + 1, end);
+            return Token{ std::string_view(first, pos),
+                          TokenKind::NumericLiteral };
         }
-        auto matchChar = [&](char op,
-                             TokenKind tokKind) -> std::optional<Token> {
-            if (*first == op) {
-                inc();
-                return Token{ getID(first), tokKind };
-            }
-            return std::nullopt;
-        };
-        if (auto tok = matchChar('(', TokenKind::OpenParen))
-            return *tok;
-        if (auto tok = matchChar(')', TokenKind::CloseParen))
-            return *tok;
-        if (auto tok = matchChar(';', TokenKind::Semicolon))
-            return *tok;
-        if (auto tok = matchChar(',', TokenKind::Comma))
-            return *tok;
-        if (auto tok = matchChar('=', TokenKind::Assign))
-            return *tok;
-        if (auto tok = matchChar('+', TokenKind::Add))
-            return *tok;
-        if (auto tok = matchChar('-', TokenKind::Sub))
-            return *tok;
-        if (auto tok = matchChar('*', TokenKind::Mul))
-            return *tok;
-        if (auto tok = matchChar('/', TokenKind::Div))
-            return *tok;
-        if (auto tok = matchChar('^', TokenKind::Pow))
-            return *tok;
-        throw std::runtime_error("Failed to scan token");
+        TokenKind kind = Punctuators[(uint8_t)*first];
+        if (kind == TokenKind::End) {
+            throw std::runtime_error("Failed to scan token");
+        }
+        ++pos;
+        return Token{ std::string_view(first, pos), kind };
     }
-};
 
-template <typename T, typename... Args>
-requires std::constructible_from<T, Args...>
-DynUniquePtr<T> allocate(Args&&... args) {
-    return DynUniquePtr<T>(new T(std::forward<Args>(args)...));
-}
+private:
+    char const* pos;
+    char const* end;
+};
 
 class Parser {
 public:
-    explicit Parser(Lexer lexer): lexer(lexer) {}
-
-    explicit Parser(std::string_view text): lexer(text) {}
+    explicit Parser(std::string_view text, ASTStorage::Mode mode):
+        lexer(text), text(text), mode(mode) {}
 
+    /// Parses the remaining text into one program
     DynUniquePtr<Program> parse() {
-        std::vector<DynUniquePtr<ASTNode>> statements;
+        storage = std::make_unique<ASTStorage>(mode, arenaSizeHint(text));
+        std::vector<ASTNode*> statements;
         while (true) {
-            if (auto stmt = parseStmt()) {
-                statements.push_back(std::move(stmt));
+            if (auto* stmt = parseStmt()) {
+                statements.push_back(stmt);
             }
             else {
-                return allocate<Program>(std::move(statements));
+                return makeProgram(statements);
             }
         }
     }
 
+    /// Parses the next statement into a program of its own, so every
+    /// statement can be destroyed after it ran. \Returns `nullptr` at the end
+    /// of the text
+    DynUniquePtr<Program> parseNext() {
+        storage = std::make_unique<ASTStorage>(mode, 0);
+        ASTNode* stmt = parseStmt();
+        if (!stmt) {
+            return nullptr;
+        }
+        return makeProgram({ &stmt, 1 });
+    }
+
 private:
-    DynUniquePtr<Expr> parseExpr() { return parseBinaryExpr(); }
+    /// Guess for the number of bytes of the nodes of a program with the source
+    /// \p text. The arena grows if the guess is too small
+    static size_t arenaSizeHint(std::string_view text) {
+        return text.size() * 8;
+    }
+
+    DynUniquePtr<Program> makeProgram(std::span<ASTNode* const> statements) {
+        auto children = copyChildren(statements);
+        return DynUniquePtr<Program>(new Program(std::move(storage), children));
+    }
+
+    template <typename T, typename... Args>
+    T* allocate(Args&&... args) {
+        return storage->make<T>(std::forward<Args>(args)...);
+    }
+
+    std::span<ASTNode*> copyChildren(std::span<ASTNode* const> nodes) {
+        auto children = storage->makeChildArray(nodes.size());
+        std::copy(nodes.begin(), nodes.end(), children.begin());
+        return children;
+    }
+
+    Expr* parseExpr() { return parseBinaryExpr(); }
 
     static std::optional<BinaryExpr::Operator> toBinOp(TokenKind kind) {
         switch (kind) {
@@ -154,14 +301,14 @@ private:
         }
     }
 
-    DynUniquePtr<Expr> parseBinaryExpr() {
-        auto lhs = parseUnaryExpr();
+    Expr* parseBinaryExpr() {
+        auto* lhs = parseUnaryExpr();
         while (true) {
             if (auto op = toBinOp(peek().kind)) {
                 eat();
-                auto rhs = parseExpr();
-                expect(rhs.get(), "expression");
-                lhs = allocate<BinaryExpr>(*op, std::move(lhs), std::move(rhs));
+                auto* rhs = parseExpr();
+                expect(rhs, "expression");
+                lhs = allocate<BinaryExpr>(*op, lhs, rhs);
             }
             return lhs;
         }
@@ -175,71 +322,71 @@ private:
         }
     }
 
-    DynUniquePtr<Expr> parseUnaryExpr() {
+    Expr* parseUnaryExpr() {
         if (auto op = toUnOp(peek().kind)) {
             eat();
-            auto operand = parseExpr();
-            expect(operand.get(), "expression");
-            return allocate<UnaryExpr>(*op, std::move(operand));
+            auto* operand = parseExpr();
+            expect(operand, "expression");
+            return allocate<UnaryExpr>(*op, operand);
         }
         return parseCallExpr();
     }
 
-    template <typename T = Expr>
-    std::vector<DynUniquePtr<T>> parseArgumentList(TokenKind delim) {
-        std::vector<DynUniquePtr<T>> arguments;
+    /// Appends the parsed arguments to \p arguments
+    void parseArgumentList(TokenKind delim, std::vector<ASTNode*>& arguments) {
         bool first = true;
         while (true) {
             if (peek().kind == delim) {
                 eat();
-                return arguments;
+                return;
             }
             if (!first) {
                 expect(eat(), TokenKind::Comma);
             }
             first = false;
-            auto arg = parseExpr();
-            expect(arg.get(), "expression");
-            arguments.push_back(std::move(arg));
+            auto* arg = parseExpr();
+            expect(arg, "expression");
+            arguments.push_back(arg);
         }
     }
 
-    DynUniquePtr<Expr> parseCallExpr() {
-        auto prim = parsePrimary();
+    Expr* parseCallExpr() {
+        auto* prim = parsePrimary();
         if (peek().kind != TokenKind::OpenParen) {
             return prim;
         }
         eat();
-        auto arguments = parseArgumentList(TokenKind::CloseParen);
-        return allocate<CallExpr>(std::move(prim), std::move(arguments));
+        std::vector<ASTNode*> children = { prim };
+        parseArgumentList(TokenKind::CloseParen, children);
+        return allocate<CallExpr>(copyChildren(children));
     }
 
-    DynUniquePtr<Expr> parsePrimary() {
+    Expr* parsePrimary() {
         if (peek().kind == TokenKind::OpenParen) {
             eat();
-            auto expr = parseExpr();
+            auto* expr = parseExpr();
             expect(eat(), TokenKind::CloseParen);
             return expr;
         }
-        if (auto expr = parseIdentifier()) {
+        if (auto* expr = parseIdentifier()) {
             return expr;
         }
-        if (auto expr = parseLiteral()) {
+        if (auto* expr = parseLiteral()) {
             return expr;
         }
         return nullptr;
     }
 
-    DynUniquePtr<Identifier> parseIdentifier() {
+    Identifier* parseIdentifier() {
         auto tok = peek();
         if (tok.kind == TokenKind::Identifier) {
             eat();
-            return allocate<Identifier>(std::string(tok.ID));
+            return allocate<Identifier>(storage->copyString(tok.ID));
         }
         return nullptr;
     }
 
-    DynUniquePtr<Literal> parseLiteral() {
+    Literal* parseLiteral() {
         auto tok = peek();
         if (tok.kind == TokenKind::NumericLiteral) {
             eat();
@@ -248,14 +395,14 @@ private:
         return nullptr;
     }
 
-    DynUniquePtr<Statement> parseStmt() {
+    Statement* parseStmt() {
         if (peek().kind == TokenKind::Let) {
             return parseVarDecl();
         }
-        if (auto stmt = parseExprStmt()) {
+        if (auto* stmt = parseExprStmt()) {
             return stmt;
         }
-        if (auto stmt = parseInstrStmt()) {
+        if (auto* stmt = parseInstrStmt()) {
             return stmt;
         }
         if (peek().kind == TokenKind::Semicolon) {
@@ -265,16 +412,16 @@ private:
         return nullptr;
     }
 
-    DynUniquePtr<VarDecl> parseVarDecl() {
+    VarDecl* parseVarDecl() {
         assert(peek().kind == TokenKind::Let);
         eat();
-        auto name = parseIdentifier();
-        expect(name.get(), "identifier");
+        auto* name = parseIdentifier();
+        expect(name, "identifier");
         expect(eat(), TokenKind::Assign);
-        auto initExpr = parseExpr();
-        expect(initExpr.get(), "expression");
+        auto* initExpr = parseExpr();
+        expect(initExpr, "expression");
         expect(eat(), TokenKind::Semicolon);
-        return allocate<VarDecl>(std::move(name), std::move(initExpr));
+        return allocate<VarDecl>(name, initExpr);
     }
 
     static std::optional<InstrStatement::Instruction> toInstr(TokenKind kind) {
@@ -285,22 +432,23 @@ private:
         }
     }
 
-    DynUniquePtr<InstrStatement> parseInstrStmt() {
+    InstrStatement* parseInstrStmt() {
         if (auto instr = toInstr(peek().kind)) {
             eat();
-            auto args = parseArgumentList<ASTNode>(TokenKind::Semicolon);
-            return allocate<InstrStatement>(*instr, std::move(args));
+            std::vector<ASTNode*> args;
+            parseArgumentList(TokenKind::Semicolon, args);
+            return allocate<InstrStatement>(*instr, copyChildren(args));
         }
         return nullptr;
     }
 
-    DynUniquePtr<ExprStatement> parseExprStmt() {
-        auto expr = parseExpr();
+    ExprStatement* parseExprStmt() {
+        auto* expr = parseExpr();
         if (!expr) {
             return nullptr;
         }
         expect(eat(), TokenKind::Semicolon);
-        return allocate<ExprStatement>(std::move(expr));
+        return allocate<ExprStatement>(expr);
     }
 
     void expect(ASTNode const* node, std::string const& kind) {
@@ -316,26 +464,100 @@ private:
     }
 
     Token peek() {
-        if (!current) {
-            current = lexer.next();
+        if (current == tokens.size()) {
+            lexer.tokenize(tokens, TokenBatchSize);
+            current = 0;
         }
-        return *current;
+        return tokens[current];
     }
 
     Token eat() {
-        if (current) {
-            return *std::exchange(current, std::nullopt);
+        Token token = peek();
+        if (token.kind != TokenKind::End) {
+            ++current;
         }
-        return lexer.next();
+        return token;
     }
 
+    static constexpr size_t TokenBatchSize = 256;
+
     Lexer lexer;
-    std::optional<Token> current;
+    std::vector<Token> tokens;
+    size_t current = 0;
+    std::string_view text;
+    ASTStorage::Mode mode;
+    std::unique_ptr<ASTStorage> storage;
 };
 
+/// Binds calls to builtin functions
+void resolveCall(CallExpr& call) {
+    auto* ID = csp::dyncast<Identifier const*>(call.callee());
+    if (!ID) {
+        throw std::runtime_error("Cannot call expression");
+    }
+    auto* builtin = findBuiltin(ID->value());
+    if (!builtin) {
+        throw std::runtime_error("Use of unknown function: " +
+                                 std::string(ID->value()));
+    }
+    if (call.argumentSpan().size() != builtin->arity) {
+        throw std::runtime_error("Invalid number of arguments");
+    }
+    call.setBuiltin(builtin);
+}
+
+/// Assigns slots to the identifiers and binds the calls in the tree rooted at
+/// \p root. Callees are function names and keep `Identifier::NoSlot`
+void resolve(ASTNode& root, SymbolTable& symbols) {
+    auto children = [](ASTNode& node) { return node.children(); };
+    // clang-format off
+    csp::traverse(root, children, csp::overload{
+        [&](Identifier& ID) {
+            ID.setSlot(symbols.slot(ID.value()));
+            return csp::traverse_control::proceed;
+        },
+        [&](CallExpr& call) {
+            resolveCall(call);
+            for (auto* arg : call.arguments()) {
+                resolve(*arg, symbols);
+            }
+            return csp::traverse_control::skip_children;
+        },
+        [](ASTNode&) { return csp::traverse_control::proceed; },
+    }); // clang-format on
+}
+
 } // namespace
 
-DynUniquePtr<Program> examples::parse(std::string source) {
-    Parser parser(source);
-    return parser.parse();
+DynUniquePtr<Program> examples::parse(std::string source,
+                                      SymbolTable& symbols,
+                                      ASTStorage::Mode mode) {
+    Parser parser(source, mode);
+    auto program = parser.parse();
+    resolve(*program, symbols);
+    program->setNumSlots(symbols.size());
+    return program;
+}
+
+struct StatementParser::Impl {
+    Impl(std::string_view source, SymbolTable& symbols, ASTStorage::Mode mode):
+        parser(source, mode), symbols(symbols) {}
+
+    Parser parser;
+    SymbolTable& symbols;
+};
+
+StatementParser::StatementParser(std::string_view source,
+                                 SymbolTable& symbols, ASTStorage::Mode mode):
+    impl(std::make_unique<Impl>(source, symbols, mode)) {}
+
+StatementParser::~StatementParser() = default;
+
+DynUniquePtr<Program> StatementParser::next() {
+    auto program = impl->parser.parseNext();
+    if (program) {
+        resolve(*program, impl->symbols);
+        program->setNumSlots(impl->symbols.size());
+    }
+    return program;
 }
@@ -1,13 +1,36 @@
 #ifndef PARSER_HPP
 #define PARSER_HPP
 
+#include <memory>
 #include <string>
+#include <string_view>
 
 #include "ast.hpp"
 
 namespace examples {
 
-DynUniquePtr<Program> parse(std::string source);
+/// Parses \p source, assigns the variables slots in \p symbols and binds calls
+/// to builtin functions. \p mode selects how the nodes are allocated
+DynUniquePtr<Program> parse(std::string source, SymbolTable& symbols,
+                            ASTStorage::Mode mode = ASTStorage::Arena);
+
+/// Parses a source text one statement at a time. The text is not copied and
+/// must outlive the parser, so it can be a memory mapped file
+class StatementParser {
+public:
+    explicit StatementParser(std::string_view source, SymbolTable& symbols,
+                             ASTStorage::Mode mode = ASTStorage::Arena);
+
+    ~StatementParser();
+
+    /// \Returns a program that contains the next statement, or `nullptr` at
+    /// the end of the source
+    DynUniquePtr<Program> next();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
 
 } // namespace examples
 
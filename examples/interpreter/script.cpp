@@ -0,0 +1,118 @@
+#include "script.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "optimizer.hpp"
+#include "parser.hpp"
+
+using namespace examples;
+
+namespace {
+
+/// Queue that blocks producers while it is full and consumers while it is
+/// empty
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity): capacity(capacity) {}
+
+    /// Appends \p value, waiting for room if necessary. \Returns `false` if
+    /// the queue is closed
+    bool push(T value) {
+        std::unique_lock lock(mutex);
+        notFull.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(value));
+        /// Only a consumer that found the queue empty can be waiting
+        if (items.size() == 1) {
+            notEmpty.notify_one();
+        }
+        return true;
+    }
+
+    /// Removes the first value, waiting for one if necessary. \Returns
+    /// `std::nullopt` once the queue is closed and empty
+    std::optional<T> pop() {
+        std::unique_lock lock(mutex);
+        notEmpty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        T value = std::move(items.front());
+        items.pop_front();
+        if (items.size() == capacity - 1) {
+            notFull.notify_one();
+        }
+        return value;
+    }
+
+    /// Rejects further values. Values that are already queued can still be
+    /// popped
+    void close() {
+        std::lock_guard lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notFull, notEmpty;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+/// A parsed statement or the error that ended parsing
+struct ParsedStatement {
+    DynUniquePtr<Program> program;
+    std::exception_ptr error;
+    size_t eliminatedNodes = 0;
+};
+
+} // namespace
+
+ScriptStats examples::runScript(std::string_view source,
+                                Interpreter& interpreter,
+                                ScriptOptions const& options) {
+    BoundedQueue<ParsedStatement> queue(options.queueCapacity);
+    /// Only the producer accesses the symbol table
+    std::jthread producer([&] {
+        StatementParser parser(source, interpreter.symbols());
+        try {
+            while (auto program = parser.next()) {
+                size_t eliminated = options.optimize ? optimize(*program) : 0;
+                if (!queue.push({ std::move(program), nullptr, eliminated })) {
+                    return;
+                }
+            }
+        }
+        catch (...) {
+            queue.push({ nullptr, std::current_exception() });
+        }
+        queue.close();
+    });
+    /// Closing the queue when we stop early releases the producer if it waits
+    /// for room
+    struct CloseGuard {
+        BoundedQueue<ParsedStatement>& queue;
+        ~CloseGuard() { queue.close(); }
+    } closeGuard{ queue };
+    ScriptStats stats;
+    while (auto stmt = queue.pop()) {
+        if (stmt->error) {
+            std::rethrow_exception(stmt->error);
+        }
+        ++stats.numStatements;
+        stats.eliminatedNodes += stmt->eliminatedNodes;
+        interpreter.runOnce(*stmt->program);
+    }
+    return stats;
+}
@@ -0,0 +1,36 @@
+#ifndef SCRIPT_HPP
+#define SCRIPT_HPP
+
+#include <cstddef>
+#include <string_view>
+
+#include "interpreter.hpp"
+
+namespace examples {
+
+struct ScriptOptions {
+    /// Maximum number of parsed statements that wait to be run
+    size_t queueCapacity = 64;
+
+    /// Runs `optimize()` on every statement after it is parsed
+    bool optimize = false;
+};
+
+struct ScriptStats {
+    size_t numStatements = 0;
+
+    /// Number of nodes eliminated by `optimize()`
+    size_t eliminatedNodes = 0;
+};
+
+/// Runs the script \p source with \p interpreter. A second thread parses the
+/// statements while the calling thread runs them. At most
+/// `options.queueCapacity` parsed statements wait to be run and every
+/// statement is destroyed after it ran, so memory use does not grow with the
+/// size of the script. Rethrows the first error in script order
+ScriptStats runScript(std::string_view source, Interpreter& interpreter,
+                      ScriptOptions const& options = {});
+
+} // namespace examples
+
+#endif // SCRIPT_HPP
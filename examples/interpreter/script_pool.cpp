@@ -0,0 +1,105 @@
+#include "script_pool.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <exception>
+
+#include "csp/parallel.hpp"
+
+#include "mapped_file.hpp"
+#include "optimizer.hpp"
+#include "parser.hpp"
+#include "utils.hpp"
+
+using namespace examples;
+
+namespace {
+
+/// Appends the output of the interpreter to a string
+struct CollectingDelegate: InterpreterDelegate {
+    std::string* output = nullptr;
+
+    void print(double value) override { append(value); }
+
+    void eval(double value) override { append(value); }
+
+    void quit() override { throw QuitException(); }
+
+    /// Same format as `std::cout << value`
+    void append(double value) {
+        char buffer[32];
+        int size = std::snprintf(buffer, sizeof buffer, ">> %g\n", value);
+        output->append(buffer, (size_t)size);
+    }
+};
+
+class Worker {
+public:
+    explicit Worker(ScriptPoolOptions const& options):
+        interpreter(delegate, options.mode), optimizeInput(options.optimize) {}
+
+    ScriptResult run(std::string const& path) {
+        ScriptResult result;
+        delegate.output = &result.output;
+        auto start = std::chrono::steady_clock::now();
+        try {
+            MappedFile file(path);
+            interpreter.reset();
+            StatementParser parser(file.text(), interpreter.symbols());
+            while (auto program = parser.next()) {
+                if (optimizeInput) {
+                    optimize(*program);
+                }
+                interpreter.runOnce(*program);
+            }
+        }
+        catch (QuitException const&) {
+        }
+        catch (std::exception const& e) {
+            fail(result, e.what());
+        }
+        catch (...) {
+            fail(result, "Unknown exception");
+        }
+        result.latency = std::chrono::steady_clock::now() - start;
+        return result;
+    }
+
+private:
+    static void fail(ScriptResult& result, char const* message) {
+        result.output += "Error: ";
+        result.output += message;
+        result.output += '\n';
+        result.success = false;
+    }
+
+    CollectingDelegate delegate;
+    Interpreter interpreter;
+    bool optimizeInput;
+};
+
+} // namespace
+
+std::vector<ScriptResult> examples::runScripts(
+    std::span<std::string const> paths, ScriptPoolOptions const& options) {
+    std::vector<ScriptResult> results(paths.size());
+    size_t numThreads =
+        std::min(std::max(options.numThreads, size_t(1)), paths.size());
+    csp::work_stealing_pool pool(numThreads);
+    // One worker per thread of the pool. The calling thread runs scripts
+    // while it waits and uses the worker with index 0
+    std::deque<Worker> workers;
+    for (size_t i = 0; i < pool.num_threads(); ++i) {
+        workers.emplace_back(options);
+    }
+    // Every script is a task, so threads that are done with their share of
+    // the scripts steal from threads that got long ones
+    auto runScript = [&](size_t index) {
+        results[index] = workers[pool.this_thread_index()].run(paths[index]);
+    };
+    csp::task_group group;
+    pool.spawn_n(group, paths.size(), runScript);
+    pool.wait(group);
+    return results;
+}
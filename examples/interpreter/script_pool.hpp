@@ -0,0 +1,46 @@
+#ifndef SCRIPT_POOL_HPP
+#define SCRIPT_POOL_HPP
+
+/// This file defines a driver that runs many independent scripts in parallel
+
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "interpreter.hpp"
+
+namespace examples {
+
+struct ScriptPoolOptions {
+    size_t numThreads = 1;
+
+    InterpreterMode mode = InterpreterMode::Bytecode;
+
+    /// Runs `optimize()` on every statement after it is parsed
+    bool optimize = false;
+};
+
+struct ScriptResult {
+    /// The values that the script printed, one per line, followed by the
+    /// error that ended the script if it failed
+    std::string output;
+
+    bool success = true;
+
+    /// Time to map, parse and run the script
+    std::chrono::nanoseconds latency{};
+};
+
+/// Runs the scripts at \p paths on a `csp::work_stealing_pool` with
+/// `options.numThreads` threads. Every thread owns one `Interpreter` that is
+/// reset before each script, so the scripts don't share any state. Exceptions
+/// are reported in the result of the script that threw them. \Returns the
+/// results in the order of \p paths
+std::vector<ScriptResult> runScripts(std::span<std::string const> paths,
+                                     ScriptPoolOptions const& options);
+
+} // namespace examples
+
+#endif // SCRIPT_POOL_HPP
@@ -14,3 +14,10 @@ void examples::format(Format f) {
     case Format::Reset: printf("\033[00m"); break;
     }
 }
+
+void examples::printError(char const* message) {
+    format(Format::Red, Format::Bold);
+    printf("Error: ");
+    format(Format::Reset);
+    printf("%s\n", message);
+}
@@ -1,6 +1,7 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
 
+#include <chrono>
 #include <concepts>
 #include <exception>
 
@@ -14,6 +15,13 @@ void format(std::same_as<Format> auto... f) {
     (format(f), ...);
 }
 
+/// Prints "Error: " followed by \p message
+void printError(char const* message);
+
+inline double toMilliseconds(std::chrono::nanoseconds duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
 struct QuitException: std::exception {
     char const* what() const noexcept { return "quit"; }
 };
@@ -29,6 +29,8 @@
 #include <cassert>
 #include <cstddef>
 #include <memory> // For std::destroy_at and std::unique_ptr
+#include <new>    // For sized and aligned operator delete
+#include <tuple>  // For std::tuple in fuse
 #include <type_traits>
 #include <typeinfo> // For std::bad_cast
 #include <utility>  // For std::index_sequence
@@ -500,6 +502,19 @@ struct RebindSmartPtrImpl<P<T, Args...>, To> {
 template <typename P, typename To>
 using RebindSmartPtr = typename RebindSmartPtrImpl<P, To>::type;
 
+/// Constructs the smart pointer \p Result from the raw pointer \p ptr that
+/// has been released from \p p. If the smart pointer has a deleter, it is
+/// transferred so stateful deleters survive casts.
+template <typename Result, typename P, typename Ptr>
+constexpr Result transferSmartPtr(P& p, Ptr ptr) {
+    if constexpr (requires { Result(ptr, std::move(p.get_deleter())); }) {
+        return Result(ptr, std::move(p.get_deleter()));
+    }
+    else {
+        return Result(ptr);
+    }
+}
+
 /// MARK: - isa
 
 /// \Returns `true` if \p TestID is a super class of \p ActualID
@@ -630,8 +645,10 @@ struct DyncastFn {
     CSP_IMPL_NODEBUG constexpr RebindSmartPtr<
         Known, copy_cvref_t<PointeeType<Known>, To>>
     operator()(Known&& p) const {
-        return RebindSmartPtr<Known, copy_cvref_t<PointeeType<Known>, To>>(
-            dyncastImpl<copy_cvref_t<PointeeType<Known>, To>*>(p.release()));
+        using Result =
+            RebindSmartPtr<Known, copy_cvref_t<PointeeType<Known>, To>>;
+        return transferSmartPtr<Result>(
+            p, dyncastImpl<copy_cvref_t<PointeeType<Known>, To>*>(p.release()));
     }
 };
 
@@ -673,8 +690,10 @@ struct UnsafeCastFn {
     CSP_IMPL_NODEBUG constexpr RebindSmartPtr<
         Known, copy_cvref_t<PointeeType<Known>, To>>
     operator()(Known&& p) const {
-        return RebindSmartPtr<Known, copy_cvref_t<PointeeType<Known>, To>>(
-            castImpl<copy_cvref_t<PointeeType<Known>, To>*>(p.release()));
+        using Result =
+            RebindSmartPtr<Known, copy_cvref_t<PointeeType<Known>, To>>;
+        return transferSmartPtr<Result>(
+            p, castImpl<copy_cvref_t<PointeeType<Known>, To>*>(p.release()));
     }
 };
 
@@ -1090,6 +1109,40 @@ struct dyn_destructor {
 /// Calls `std::destroy_at` on the most derived type
 inline constexpr dyn_destructor dyn_destroy{};
 
+namespace impl {
+
+template <typename T>
+concept HasClassOperatorDelete =
+    requires(void* p) { T::operator delete(p); } ||
+    requires(void* p) { T::operator delete(p, sizeof(T)); };
+
+/// Destroys \p object and returns its memory through the sized (and if
+/// necessary aligned) global `operator delete`. Since `visit` already gives us
+/// the most derived type, we can always pass the exact size.
+template <typename T>
+constexpr void sizedDelete(T* object) {
+    if constexpr (HasClassOperatorDelete<T>) {
+        delete object;
+    }
+    else {
+        if (std::is_constant_evaluated()) {
+            delete object;
+            return;
+        }
+        using U = std::remove_cv_t<T>;
+        void* address = const_cast<U*>(object);
+        std::destroy_at(object);
+        if constexpr (alignof(U) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(address, sizeof(U), std::align_val_t(alignof(U)));
+        }
+        else {
+            ::operator delete(address, sizeof(U));
+        }
+    }
+}
+
+} // namespace impl
+
 struct dyn_deleter {
     template <typename T>
     requires impl::Dynamic<T> && impl::ExternallyDeletable<T>
@@ -1099,11 +1152,11 @@ struct dyn_deleter {
     }
     constexpr void operator()(impl::Dynamic auto* object) const {
         assert(object && "object must not be null");
-        visit(*object, [](auto& derived) { delete &derived; });
+        visit(*object, [](auto& derived) { impl::sizedDelete(&derived); });
     }
 };
 
-/// Calls `delete` on the most derived type
+/// Calls sized `delete` on the most derived type
 inline constexpr dyn_deleter dyn_delete{};
 
 /// Typedef for `unique_ptr` using `dyn_deleter`
@@ -1117,6 +1170,18 @@ constexpr unique_ptr<T> make_unique(Args&&... args) {
     return unique_ptr<T>(new T((Args&&)args...));
 }
 
+/// Creates a copy of \p object with the copy constructor of its most derived
+/// type. No virtual `clone()` function is required.
+template <impl::Dynamic T>
+constexpr unique_ptr<std::remove_cv_t<T>> clone(T const& object) {
+    using Result = unique_ptr<std::remove_cv_t<T>>;
+    return visit(object, []<typename Derived>(Derived const& derived) {
+        static_assert(std::is_copy_constructible_v<Derived>,
+                      "All concrete types must be copy constructible");
+        return Result(make_unique<Derived>(derived));
+    });
+}
+
 /// MARK: Union
 
 namespace impl {
@@ -1143,7 +1208,7 @@ union UnionImpl<Head> {
 /// whose type satisfies the predicate \p Pred
 template <template <class> class Pred, typename U>
 constexpr decltype(auto) unionFind(U&& u) {
-    using R = copy_cvref_t<U, decltype(u.head)>;
+    using R = copy_cvref_t<U&&, decltype(u.head)>;
     constexpr bool Found = Pred<R>::value;
     if constexpr (Found) {
         return (R)u.head;
@@ -1219,7 +1284,7 @@ struct DynUnion<Base, TypeList<Args...>> {
         std::conjunction_v<std::is_nothrow_move_assignable<Args>...>;
 
     template <typename T, typename Impl>
-    static copy_cvref_t<Impl, T> getImpl(Impl&& impl) {
+    static copy_cvref_t<Impl&&, T> getImpl(Impl&& impl) {
         // TODO: static assert that all of Args... that are derived from T have
         // the same offset to T
         using R = copy_cvref_t<Impl&&, T>;
@@ -1342,6 +1407,52 @@ private:
     dyn_union(impl::UnionNoInit) {}
 };
 
+/// # Range element access
+
+namespace impl {
+
+/// \Returns a reference to the object that the range element \p elem refers
+/// to. Elements can be pointers, smart pointers, `dyn_union`s or objects of
+/// dynamic types. This is used by algorithms over heterogeneous ranges
+template <typename E>
+constexpr decltype(auto) derefElement(E&& elem) {
+    using D = std::remove_cvref_t<E>;
+    if constexpr (std::is_pointer_v<D> || DynSmartPtr<D>) {
+        return *elem;
+    }
+    else if constexpr (!Dynamic<D> && requires { ((E&&)elem).base(); }) {
+        return ((E&&)elem).base();
+    }
+    else {
+        return (E&&)elem;
+    }
+}
+
+/// Evaluates to the class type of the objects referred to by elements of type
+/// \p E
+template <typename E>
+using ElementObjectType = std::remove_cvref_t<decltype(derefElement(
+    std::declval<E&>()))>;
+
+/// \Returns the runtime type ID of the object \p elem refers to
+template <typename E>
+constexpr auto elementRTTI(E const& elem) {
+    return get_rtti(derefElement(elem));
+}
+
+/// \Returns `true` if \p elem is a null pointer or null smart pointer
+template <typename E>
+constexpr bool isNullElement(E const& elem) {
+    if constexpr (std::is_pointer_v<E> || DynSmartPtr<E>) {
+        return elem == nullptr;
+    }
+    else {
+        return false;
+    }
+}
+
+} // namespace impl
+
 /// # Base helper
 
 /// ** Read this if compilation fails here: **
@@ -1490,6 +1601,81 @@ struct overload: private impl::ToFunctionT<F>... {
 template <typename... F>
 overload(F...) -> overload<F...>;
 
+/// # Fuse
+
+/// Placeholder for the results of fused functions that return `void`
+struct fused_void {
+    constexpr bool operator==(fused_void const&) const = default;
+};
+
+namespace impl {
+
+template <typename F, typename... T>
+concept FusedInvocable = requires(F& f, T&&... t) { f((T&&)t...); };
+
+template <typename F, typename... T>
+constexpr auto invokeFused(F& f, T&&... t) {
+    if constexpr (std::is_void_v<decltype(f((T&&)t...))>) {
+        f((T&&)t...);
+        return fused_void{};
+    }
+    else {
+        return f((T&&)t...);
+    }
+}
+
+} // namespace impl
+
+/// Combines multiple function objects into one that invokes all of them in
+/// order and returns a `std::tuple` of their results. `void` results are
+/// replaced by `fused_void`.
+///
+/// Passing a fused visitor to `visit()` runs several visitors with a single
+/// dispatch:
+///
+///     auto [count, size] = visit(node, fuse{ countVisitor, sizeVisitor });
+///
+template <typename... F>
+struct fuse {
+    /// Excludes a single `fuse` argument so copies use the copy constructor
+    template <typename... G>
+    requires(sizeof...(G) == sizeof...(F) &&
+             !(std::is_same_v<std::remove_cvref_t<G>, fuse> && ...))
+    constexpr fuse(G&&... g): functions((G&&)g...) {}
+
+    template <typename... T>
+    requires(impl::FusedInvocable<F, T...> && ...)
+    constexpr auto operator()(T&&... t) {
+        return invoke(functions, (T&&)t...);
+    }
+
+    template <typename... T>
+    requires(impl::FusedInvocable<F const, T...> && ...)
+    constexpr auto operator()(T&&... t) const {
+        return invoke(functions, (T&&)t...);
+    }
+
+    std::tuple<F...> functions;
+
+private:
+    template <typename Functions, typename... T>
+    static constexpr auto invoke(Functions& functions, T&&... t) {
+        return std::apply(
+            [&](auto&... f) {
+            /// Braced initialization evaluates the calls from left to right.
+            /// The explicit type keeps CTAD from copying the result of a
+            /// single function that returns a tuple
+            return std::tuple<decltype(impl::invokeFused(f, (T&&)t...))...>{
+                impl::invokeFused(f, (T&&)t...)...
+            };
+        },
+            functions);
+    }
+};
+
+template <typename... F>
+fuse(F...) -> fuse<F...>;
+
 } // namespace csp
 
 /// # range utilities
@@ -1519,6 +1705,90 @@ inline constexpr auto filter =
 #endif // __has_include (<ranges>)
 #endif // defined __has_include
 
+/// # Polymorphic memory resources
+
+#if defined __has_include
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+
+#define CSP_IMPL_HAS_PMR 1
+
+namespace csp::pmr {
+
+/// Deleter for objects allocated with `csp::pmr::make_unique`. Stores the
+/// memory resource the object was allocated from and returns the memory of the
+/// most derived type with its exact size and alignment.
+///
+/// Objects are destroyed through `do_destroy` if it is declared for their type,
+/// like `csp::dyn_destroy`. A custom `do_delete` would free the memory behind
+/// the back of the resource, so types that declare one must also declare
+/// `do_destroy` to be used with this deleter.
+class dyn_deleter {
+public:
+    /// Default constructed deleters use the default resource, just like
+    /// `std::pmr::polymorphic_allocator`
+    dyn_deleter() noexcept: _resource(std::pmr::get_default_resource()) {}
+
+    dyn_deleter(std::pmr::memory_resource* resource) noexcept:
+        _resource(resource) {
+        assert(resource && "resource must not be null");
+    }
+
+    template <impl::Dynamic T>
+    void operator()(T* object) const {
+        static_assert(!impl::ExternallyDeletable<T> ||
+                          impl::ExternallyDestructible<T>,
+                      "Types with a custom do_delete must declare do_destroy "
+                      "to be deleted through a memory resource");
+        assert(object && "object must not be null");
+        visit(*object, [&]<typename Derived>(Derived& derived) {
+            using U = std::remove_cv_t<Derived>;
+            void* address = const_cast<U*>(&derived);
+            if constexpr (impl::ExternallyDestructible<T>) {
+                do_destroy(*object);
+            }
+            else {
+                std::destroy_at(&derived);
+            }
+            _resource->deallocate(address, sizeof(U), alignof(U));
+        });
+    }
+
+    /// \Returns the memory resource objects are deallocated through
+    std::pmr::memory_resource* resource() const noexcept { return _resource; }
+
+private:
+    std::pmr::memory_resource* _resource;
+};
+
+/// Typedef for `unique_ptr` using `csp::pmr::dyn_deleter`
+template <typename T>
+using unique_ptr = std::unique_ptr<T, dyn_deleter>;
+
+/// Allocates an object of type \p T from \p resource and wraps it in a
+/// `csp::pmr::unique_ptr` that returns the memory to \p resource
+template <typename T, typename... Args>
+requires std::constructible_from<T, Args...>
+unique_ptr<T> make_unique(std::pmr::memory_resource* resource,
+                          Args&&... args) {
+    assert(resource && "resource must not be null");
+    void* memory = resource->allocate(sizeof(T), alignof(T));
+    T* object;
+    try {
+        object = ::new (memory) T((Args&&)args...);
+    }
+    catch (...) {
+        resource->deallocate(memory, sizeof(T), alignof(T));
+        throw;
+    }
+    return unique_ptr<T>(object, dyn_deleter(resource));
+}
+
+} // namespace csp::pmr
+
+#endif // __has_include(<memory_resource>)
+#endif // defined __has_include
+
 /// # Undef
 
 #if !defined(CSP_IMPL_ENABLE_DEBUGGING)
@@ -0,0 +1,143 @@
+#ifndef CSP_BATCH_HPP
+#define CSP_BATCH_HPP
+
+#include <ranges>
+#include <vector>
+
+#include "column.hpp"
+
+/// # Batch visitation
+///
+/// Calling `visit` element by element over a range of objects of random
+/// runtime types makes the indirect call through the dispatch table
+/// unpredictable. The algorithms in this file first group the elements by
+/// type and then run one monomorphic loop per concrete type, so the visitor
+/// is invoked directly and can be inlined.
+
+namespace csp {
+
+namespace impl {
+
+/// Object type (including constness) that elements of the range \p R refer
+/// to
+template <typename R>
+using RangeObjectType = std::remove_reference_t<decltype(derefElement(
+    std::declval<std::ranges::range_reference_t<R>>()))>;
+
+/// Collects pointers to the objects of \p range and their type IDs
+template <typename Obj, typename R>
+void gatherBatch(R&& range, std::vector<Obj*>& objects,
+                 rtti_column<std::remove_cv_t<Obj>>& column) {
+    if constexpr (std::ranges::sized_range<R>) {
+        objects.reserve(std::ranges::size(range));
+        column.reserve(std::ranges::size(range));
+    }
+    for (auto&& elem : range) {
+        Obj& obj = derefElement(elem);
+        objects.push_back(&obj);
+        column.push_back(get_rtti(obj));
+    }
+}
+
+/// Invokes `fn(T& object, size_t index)` for every concrete type `T` derived
+/// from `Obj` and every object of that type. `index` is the position of the
+/// object in the input range.
+template <typename Obj, typename F>
+void forEachTypeBucket(std::vector<Obj*> const& objects,
+                       type_partition<std::remove_cv_t<Obj>> const& partition,
+                       F&& fn) {
+    using Base = std::remove_cv_t<Obj>;
+    [&]<typename... T>(TypeList<T...>) {
+        (
+            [&] {
+            using Derived = copy_cvref_t<Obj, T>;
+            for (std::uint32_t index : partition.of(TypeToID<T>)) {
+                fn(static_cast<Derived&>(*objects[index]), (size_t)index);
+            }
+        }(),
+            ...);
+    }(typename MakeTypeListDerivedConcrete<Base>::type{});
+}
+
+} // namespace impl
+
+/// Invokes \p f on every element of \p range with the element's most derived
+/// type, like `visit` would. Elements are processed grouped by concrete type in
+/// the order of the type IDs. Elements of the same type are processed in the
+/// order they appear in \p range.
+///
+/// Elements can be pointers, smart pointers, `dyn_union`s or references to
+/// objects.
+template <std::ranges::input_range R, typename F>
+requires impl::Dynamic<impl::RangeObjectType<R>>
+void visit_batch(R&& range, F&& f) {
+    using Obj = impl::RangeObjectType<R>;
+    std::vector<Obj*> objects;
+    rtti_column<std::remove_cv_t<Obj>> column;
+    impl::gatherBatch<Obj>(range, objects, column);
+    auto partition = partition_by_type(column);
+    impl::forEachTypeBucket(objects, partition,
+                            [&](auto& object, size_t) { f(object); });
+}
+
+/// Invokes \p f on every element of \p range with the element's most derived
+/// type, in the order of \p range. Runs of consecutive elements of the same
+/// runtime type are dispatched only once, after which \p f is invoked in a
+/// loop that is statically typed on the concrete type of the run. On inputs
+/// that are mostly sorted by type this reduces the cost of dispatch to almost
+/// nothing.
+///
+/// Elements can be pointers, smart pointers, `dyn_union`s or references to
+/// objects.
+template <std::ranges::input_range R, typename F>
+requires impl::Dynamic<impl::RangeObjectType<R>>
+void for_each_homogeneous(R&& range, F&& f) {
+    auto itr = std::ranges::begin(range);
+    auto const end = std::ranges::end(range);
+    if (itr == end) {
+        return;
+    }
+    /// Every element is dereferenced exactly once. `object` refers to the
+    /// first element that has not been passed to `f` or is null at the end
+    auto* object = &impl::derefElement(*itr);
+    while (object) {
+        auto const ID = get_rtti(*object);
+        csp::visit(*object, [&]<typename Derived>(Derived&) {
+            /// Consume the run of elements of type `Derived`
+            do {
+                f(static_cast<Derived&>(*object));
+                if (++itr == end) {
+                    object = nullptr;
+                    return;
+                }
+                object = &impl::derefElement(*itr);
+            } while (get_rtti(*object) == ID);
+        });
+    }
+}
+
+/// Order preserving variant of `visit_batch` for visitors that depend on the
+/// order of invocation. Invokes \p f on every element of \p range in the order
+/// of \p range like `for_each_homogeneous`, so runs of elements of the same
+/// runtime type are dispatched once.
+///
+/// \Returns a `std::vector` where the `i`-th element is the result of
+/// invoking \p f on the `i`-th element of \p range
+template <std::ranges::input_range R, typename F>
+requires impl::Dynamic<impl::RangeObjectType<R>>
+auto visit_batch_ordered(R&& range, F&& f) {
+    using Obj = impl::RangeObjectType<R>;
+    using Result =
+        std::decay_t<decltype(csp::visit(std::declval<Obj&>(), (F&&)f))>;
+    std::vector<Result> results;
+    if constexpr (std::ranges::sized_range<R>) {
+        results.reserve(std::ranges::size(range));
+    }
+    for_each_homogeneous(range,
+                         [&](auto& object) { results.push_back(f(object)); });
+    return results;
+}
+
+} // namespace csp
+
+#endif // CSP_BATCH_HPP
@@ -0,0 +1,214 @@
+#ifndef CSP_CLONE_HPP
+#define CSP_CLONE_HPP
+
+#include <algorithm> // For std::max and std::reverse
+#include <concepts>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "traverse.hpp"
+
+/// # Tree cloning
+///
+/// `clone_tree` copies a tree whose nodes refer to their children through raw
+/// pointers into a single allocation. A first pass over the source tree
+/// computes the size of the copy, a second pass copy constructs every node in
+/// place and redirects the child pointers of the copies to the copied
+/// children.
+
+namespace csp {
+
+namespace impl {
+
+struct ArenaTreeAccess;
+
+} // namespace impl
+
+/// Tree of nodes of the hierarchy of \p Base that share one allocation. The
+/// allocation starts with a table of pointers to all nodes, followed by the
+/// nodes in pre-order. Returned by `clone_tree()`
+template <impl::Dynamic Base>
+class arena_tree {
+public:
+    arena_tree() = default;
+
+    arena_tree(arena_tree&& rhs) noexcept { swap(rhs); }
+
+    arena_tree& operator=(arena_tree&& rhs) noexcept {
+        arena_tree(std::move(rhs)).swap(*this);
+        return *this;
+    }
+
+    ~arena_tree() {
+        for (Base* node : nodes()) {
+            csp::visit(*node, [](auto& derived) { std::destroy_at(&derived); });
+        }
+        if (_block) {
+            _resource->deallocate(_block, _size, _align);
+        }
+    }
+
+    /// \Returns the root of the tree or `nullptr` if the tree is empty
+    Base* root() const { return _numNodes > 0 ? nodes()[0] : nullptr; }
+
+    /// \Returns pointers to all nodes in pre-order
+    std::span<Base* const> nodes() const {
+        return { static_cast<Base* const*>(_block), _numNodes };
+    }
+
+    /// \Returns the number of nodes
+    size_t size() const { return _numNodes; }
+
+    /// \Returns the number of bytes allocated for the tree
+    size_t allocated_bytes() const { return _size; }
+
+    void swap(arena_tree& rhs) noexcept {
+        std::swap(_resource, rhs._resource);
+        std::swap(_block, rhs._block);
+        std::swap(_size, rhs._size);
+        std::swap(_align, rhs._align);
+        std::swap(_numNodes, rhs._numNodes);
+    }
+
+private:
+    friend struct impl::ArenaTreeAccess;
+
+    std::pmr::memory_resource* _resource = nullptr;
+    void* _block = nullptr;
+    size_t _size = 0;
+    size_t _align = 1;
+    size_t _numNodes = 0;
+};
+
+namespace impl {
+
+inline size_t alignUp(size_t offset, size_t align) {
+    return (offset + align - 1) / align * align;
+}
+
+/// Gives `clone_tree()` access to the internals of `arena_tree`
+struct ArenaTreeAccess {
+    template <typename Base>
+    static void allocate(arena_tree<Base>& tree,
+                         std::pmr::memory_resource& resource, size_t size,
+                         size_t align) {
+        tree._resource = &resource;
+        tree._size = size;
+        tree._align = align;
+        tree._block = resource.allocate(size, align);
+    }
+
+    template <typename Base>
+    static void push(arena_tree<Base>& tree, Base* node) {
+        static_cast<Base**>(tree._block)[tree._numNodes++] = node;
+    }
+};
+
+template <typename Children, typename Node>
+using ChildSlotReference =
+    std::ranges::range_reference_t<std::invoke_result_t<Children&, Node&>>;
+
+/// Satisfied if \p Children returns a range of references to mutable raw
+/// pointers to the mutable children of a \p Node. Owning pointers don't
+/// qualify because the nodes are copied with their copy constructors, which
+/// can't share or transfer ownership of the children
+template <typename Children, typename Node>
+concept RawChildPointers =
+    std::invocable<Children&, Node&> &&
+    std::ranges::range<std::invoke_result_t<Children&, Node&>> &&
+    std::is_lvalue_reference_v<ChildSlotReference<Children, Node>> &&
+    std::is_pointer_v<
+        std::remove_reference_t<ChildSlotReference<Children, Node>>> &&
+    !std::is_const_v<
+        std::remove_reference_t<ChildSlotReference<Children, Node>>> &&
+    !std::is_const_v<std::remove_pointer_t<
+        std::remove_reference_t<ChildSlotReference<Children, Node>>>>;
+
+} // namespace impl
+
+/// Copies the tree rooted at \p root into one allocation from \p arena.
+/// \p children is invoked with a node and must return a range of references to
+/// the raw pointers to its children, see `impl::RawChildPointers`. The same
+/// function is used to read the source tree and to redirect the pointers of
+/// the copies, so \p root must not be const. The source tree is not modified.
+/// Null pointers are skipped. All concrete
+/// node types must be copy constructible. The copy constructors copy the child
+/// pointers, which are then redirected to the copies of the children.
+///
+/// \Returns an `arena_tree` that owns the copied nodes
+template <impl::Dynamic Root, typename Children>
+requires(!std::is_const_v<Root> && impl::RawChildPointers<Children, Root>)
+auto clone_tree(Root& root, Children&& children,
+                std::pmr::memory_resource& arena =
+                    *std::pmr::get_default_resource()) {
+    using Node = impl::TraversalNodeType<Root, Children>;
+    using Slot =
+        std::remove_reference_t<impl::ChildSlotReference<Children, Node>>;
+    Node& source = root;
+    size_t numNodes = 0, bytes = 0, align = alignof(Node*);
+    std::vector<Node*> stack = { &source };
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        csp::visit(*node, [&]<typename Derived>(Derived&) {
+            bytes = impl::alignUp(bytes, alignof(Derived)) + sizeof(Derived);
+            align = std::max(align, alignof(Derived));
+        });
+        ++numNodes;
+        size_t const first = stack.size();
+        for (Slot child : std::invoke(children, *node)) {
+            if (child) {
+                stack.push_back(static_cast<Node*>(child));
+            }
+        }
+        std::reverse(stack.begin() + first, stack.end());
+    }
+    arena_tree<Node> result;
+    size_t const tableSize = impl::alignUp(numNodes * sizeof(Node*), align);
+    impl::ArenaTreeAccess::allocate(result, arena, tableSize + bytes, align);
+    std::byte* storage =
+        static_cast<std::byte*>((void*)result.nodes().data()) + tableSize;
+    size_t offset = 0;
+    /// Copies \p node and registers the copy in the node table
+    auto copyNode = [&](Node const& node) {
+        Node* copy = csp::visit(node, [&]<typename Derived>(
+                                          Derived const& derived) -> Node* {
+            offset = impl::alignUp(offset, alignof(Derived));
+            auto* object = ::new (storage + offset) Derived(derived);
+            offset += sizeof(Derived);
+            return object;
+        });
+        impl::ArenaTreeAccess::push(result, copy);
+        return copy;
+    };
+    /// Same traversal order as the counting pass, so the offsets are the same.
+    /// The stack holds the child pointers of copies that still point to the
+    /// source tree.
+    std::vector<Slot*> slots;
+    auto pushChildren = [&](Node& copy) {
+        size_t const first = slots.size();
+        for (Slot& child : std::invoke(children, copy)) {
+            if (child) {
+                slots.push_back(&child);
+            }
+        }
+        std::reverse(slots.begin() + first, slots.end());
+    };
+    pushChildren(*copyNode(source));
+    while (!slots.empty()) {
+        Slot* slot = slots.back();
+        slots.pop_back();
+        Node* child = copyNode(**slot);
+        *slot = static_cast<Slot>(child);
+        pushChildren(*child);
+    }
+    return result;
+}
+
+} // namespace csp
+
+#endif // CSP_CLONE_HPP
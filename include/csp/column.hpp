@@ -0,0 +1,429 @@
+#ifndef CSP_COLUMN_HPP
+#define CSP_COLUMN_HPP
+
+#include <array>
+#include <bit> // For std::popcount
+#include <cstdint>
+#include <ranges>
+#include <span>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define CSP_IMPL_COLUMN_SSE2 1
+#if defined(__AVX2__)
+#define CSP_IMPL_COLUMN_AVX2 1
+#endif
+#endif
+
+#include "../csp.hpp"
+
+/// # Type ID columns
+///
+/// `rtti_column` stores the runtime type IDs of a range of objects in a compact
+/// array that is kept parallel to the range. Type queries over the column
+/// never touch the objects themselves, and the kernels below test 16 or 32
+/// elements per instruction where SSE2 or AVX2 are available.
+
+namespace csp {
+
+namespace impl {
+
+/// Integral type used to store the IDs of the hierarchy of \p Base
+template <typename Base>
+using ColumnValueType =
+    std::conditional_t<(TypeToBound<Base> <= 256), std::uint8_t,
+                       std::uint16_t>;
+
+/// Compile time summary of `IsaDispatchArray<Test>`. If all IDs that pass the
+/// test form one contiguous range, the kernels use a single range comparison.
+/// Otherwise they compare against each matching ID.
+template <typename Test>
+struct ColumnIsaTest {
+    static constexpr Array Table = IsaDispatchArray<Test>;
+    static constexpr size_t Count = TypeToBound<Test>;
+
+    static constexpr size_t NumMatches = [] {
+        size_t n = 0;
+        for (size_t i = 0; i < Count; ++i) {
+            n += Table[i];
+        }
+        return n;
+    }();
+
+    static constexpr Array<size_t, NumMatches> Matches = [] {
+        Array<size_t, NumMatches> result{};
+        for (size_t i = 0, j = 0; i < Count; ++i) {
+            if (Table[i]) {
+                result[j++] = i;
+            }
+        }
+        return result;
+    }();
+
+    static constexpr size_t Low = Matches[0];
+    static constexpr size_t High = Matches[NumMatches - 1];
+    static constexpr bool Contiguous = High - Low + 1 == NumMatches;
+
+    static_assert(NumMatches > 0, "Test type must have a concrete subtype");
+};
+
+/// Scalar fallback of `columnIsaWord` for the first \p count elements at \p p.
+/// Also used for the tail of the column.
+template <typename Test, typename V>
+inline std::uint64_t columnIsaWordScalar(V const* p, size_t count) {
+    assert(count <= 64);
+    std::uint64_t word = 0;
+    for (size_t i = 0; i < count; ++i) {
+        word |= (std::uint64_t)IsaDispatchArray<Test>[p[i]] << i;
+    }
+    return word;
+}
+
+#if CSP_IMPL_COLUMN_SSE2
+
+/// Mask of all lanes of \p v that pass `Test`, one byte or word per element
+template <typename Test, typename V>
+inline __m128i columnIsaSSE2(__m128i v) {
+    using T = ColumnIsaTest<Test>;
+    if constexpr (sizeof(V) == 1) {
+        if constexpr (T::Contiguous) {
+            __m128i d = _mm_sub_epi8(v, _mm_set1_epi8((char)T::Low));
+            __m128i r =
+                _mm_subs_epu8(d, _mm_set1_epi8((char)(T::High - T::Low)));
+            return _mm_cmpeq_epi8(r, _mm_setzero_si128());
+        }
+        else {
+            __m128i m = _mm_setzero_si128();
+            for (size_t id : T::Matches.elems) {
+                m = _mm_or_si128(m,
+                                 _mm_cmpeq_epi8(v, _mm_set1_epi8((char)id)));
+            }
+            return m;
+        }
+    }
+    else {
+        if constexpr (T::Contiguous) {
+            __m128i d = _mm_sub_epi16(v, _mm_set1_epi16((short)T::Low));
+            __m128i r =
+                _mm_subs_epu16(d, _mm_set1_epi16((short)(T::High - T::Low)));
+            return _mm_cmpeq_epi16(r, _mm_setzero_si128());
+        }
+        else {
+            __m128i m = _mm_setzero_si128();
+            for (size_t id : T::Matches.elems) {
+                m = _mm_or_si128(m,
+                                 _mm_cmpeq_epi16(v, _mm_set1_epi16((short)id)));
+            }
+            return m;
+        }
+    }
+}
+
+#endif // CSP_IMPL_COLUMN_SSE2
+
+#if CSP_IMPL_COLUMN_AVX2
+
+template <typename Test, typename V>
+inline __m256i columnIsaAVX2(__m256i v) {
+    using T = ColumnIsaTest<Test>;
+    if constexpr (sizeof(V) == 1) {
+        if constexpr (T::Contiguous) {
+            __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8((char)T::Low));
+            __m256i r = _mm256_subs_epu8(
+                d, _mm256_set1_epi8((char)(T::High - T::Low)));
+            return _mm256_cmpeq_epi8(r, _mm256_setzero_si256());
+        }
+        else {
+            __m256i m = _mm256_setzero_si256();
+            for (size_t id : T::Matches.elems) {
+                m = _mm256_or_si256(
+                    m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)id)));
+            }
+            return m;
+        }
+    }
+    else {
+        if constexpr (T::Contiguous) {
+            __m256i d = _mm256_sub_epi16(v, _mm256_set1_epi16((short)T::Low));
+            __m256i r = _mm256_subs_epu16(
+                d, _mm256_set1_epi16((short)(T::High - T::Low)));
+            return _mm256_cmpeq_epi16(r, _mm256_setzero_si256());
+        }
+        else {
+            __m256i m = _mm256_setzero_si256();
+            for (size_t id : T::Matches.elems) {
+                m = _mm256_or_si256(
+                    m, _mm256_cmpeq_epi16(v, _mm256_set1_epi16((short)id)));
+            }
+            return m;
+        }
+    }
+}
+
+#endif // CSP_IMPL_COLUMN_AVX2
+
+/// Computes the `isa<Test>` bits of the 64 elements starting at \p p
+template <typename Test, typename V>
+inline std::uint64_t columnIsaWord(V const* p) {
+#if CSP_IMPL_COLUMN_AVX2
+    std::uint64_t word = 0;
+    if constexpr (sizeof(V) == 1) {
+        for (int i = 0; i < 2; ++i) {
+            __m256i v = _mm256_loadu_si256((__m256i const*)(p + 32 * i));
+            __m256i m = columnIsaAVX2<Test, V>(v);
+            word |= (std::uint64_t)(std::uint32_t)_mm256_movemask_epi8(m)
+                    << (32 * i);
+        }
+    }
+    else {
+        for (int i = 0; i < 2; ++i) {
+            __m256i a = _mm256_loadu_si256((__m256i const*)(p + 32 * i));
+            __m256i b = _mm256_loadu_si256((__m256i const*)(p + 32 * i + 16));
+            /// `packs` works per 128 bit lane, so we restore the element
+            /// order with a cross lane permutation
+            __m256i m = _mm256_permute4x64_epi64(
+                _mm256_packs_epi16(columnIsaAVX2<Test, V>(a),
+                                   columnIsaAVX2<Test, V>(b)),
+                0xD8);
+            word |= (std::uint64_t)(std::uint32_t)_mm256_movemask_epi8(m)
+                    << (32 * i);
+        }
+    }
+    return word;
+#elif CSP_IMPL_COLUMN_SSE2
+    std::uint64_t word = 0;
+    if constexpr (sizeof(V) == 1) {
+        for (int i = 0; i < 4; ++i) {
+            __m128i v = _mm_loadu_si128((__m128i const*)(p + 16 * i));
+            __m128i m = columnIsaSSE2<Test, V>(v);
+            word |= (std::uint64_t)(std::uint16_t)_mm_movemask_epi8(m)
+                    << (16 * i);
+        }
+    }
+    else {
+        for (int i = 0; i < 4; ++i) {
+            __m128i a = _mm_loadu_si128((__m128i const*)(p + 16 * i));
+            __m128i b = _mm_loadu_si128((__m128i const*)(p + 16 * i + 8));
+            __m128i m = _mm_packs_epi16(columnIsaSSE2<Test, V>(a),
+                                        columnIsaSSE2<Test, V>(b));
+            word |= (std::uint64_t)(std::uint16_t)_mm_movemask_epi8(m)
+                    << (16 * i);
+        }
+    }
+    return word;
+#else
+    return columnIsaWordScalar<Test>(p, 64);
+#endif
+}
+
+} // namespace impl
+
+/// Compact array of the runtime type IDs of a range of objects of the
+/// hierarchy of \p Base. By default IDs are stored as `uint8_t` if the
+/// hierarchy has at most 256 types and as `uint16_t` otherwise. \p Value can
+/// select `uint16_t` for smaller hierarchies as well.
+///
+/// The column can be built from a range of pointers, smart pointers,
+/// `dyn_union`s or objects, or it can be maintained incrementally along with
+/// the range it mirrors.
+template <impl::Dynamic Base, typename Value = impl::ColumnValueType<Base>>
+class rtti_column {
+public:
+    using id_type = impl::TypeToIDType<Base>;
+    using value_type = Value;
+
+    static_assert(std::is_same_v<Value, std::uint8_t> ||
+                      std::is_same_v<Value, std::uint16_t>,
+                  "IDs must be stored as uint8_t or uint16_t");
+    static_assert(impl::TypeToBound<Base> <= (size_t(1) << 8 * sizeof(Value)),
+                  "Type hierarchy too large for rtti_column");
+
+    rtti_column() = default;
+
+    /// Builds the column from the elements of \p range
+    template <std::ranges::input_range R>
+    explicit rtti_column(R&& range) {
+        assign(range);
+    }
+
+    /// Replaces the contents of the column by the IDs of the elements of
+    /// \p range
+    template <std::ranges::input_range R>
+    void assign(R&& range) {
+        _ids.clear();
+        if constexpr (std::ranges::sized_range<R>) {
+            _ids.reserve(std::ranges::size(range));
+        }
+        for (auto&& elem : range) {
+            push_back(elem);
+        }
+    }
+
+    /// Appends an ID @{
+    void push_back(id_type ID) { _ids.push_back(toValue(ID)); }
+
+    template <typename E>
+    requires(!std::is_same_v<std::remove_cvref_t<E>, id_type>)
+    void push_back(E const& elem) {
+        push_back(impl::elementRTTI(elem));
+    }
+    /// @}
+
+    /// Updates the ID at \p index, e.g. after the element has been replaced
+    void set(size_t index, id_type ID) {
+        assert(index < size());
+        _ids[index] = toValue(ID);
+    }
+
+    /// Removes the ID at \p index and shifts all subsequent IDs
+    void erase(size_t index) {
+        assert(index < size());
+        _ids.erase(_ids.begin() + (std::ptrdiff_t)index);
+    }
+
+    void pop_back() { _ids.pop_back(); }
+
+    void clear() { _ids.clear(); }
+
+    void reserve(size_t capacity) { _ids.reserve(capacity); }
+
+    size_t size() const noexcept { return _ids.size(); }
+
+    bool empty() const noexcept { return _ids.empty(); }
+
+    id_type operator[](size_t index) const {
+        assert(index < size());
+        return id_type(_ids[index]);
+    }
+
+    /// \Returns a pointer to the raw ID storage
+    value_type const* data() const noexcept { return _ids.data(); }
+
+private:
+    static value_type toValue(id_type ID) {
+        assert((size_t)ID < impl::TypeToBound<Base>);
+        return (value_type)ID;
+    }
+
+    std::vector<value_type> _ids;
+};
+
+template <std::ranges::input_range R>
+rtti_column(R&&)
+    -> rtti_column<impl::ElementObjectType<std::ranges::range_reference_t<R>>>;
+
+/// \Returns a bit mask with one bit per element of \p column that is set if
+/// `isa<Test>` holds for that element. Bit `i` is bit `i % 64` of word
+/// `i / 64`.
+template <impl::Dynamic Test, typename Base, typename Value>
+requires impl::SharesTypeHierarchyWith<Test, Base>
+std::vector<std::uint64_t> isa_mask(rtti_column<Base, Value> const& column) {
+    size_t const size = column.size();
+    std::vector<std::uint64_t> result((size + 63) / 64);
+    auto const* data = column.data();
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        result[i / 64] = impl::columnIsaWord<Test>(data + i);
+    }
+    if (i < size) {
+        result[i / 64] = impl::columnIsaWordScalar<Test>(data + i, size - i);
+    }
+    return result;
+}
+
+/// \Returns the number of elements of \p column for which `isa<Test>` holds
+template <impl::Dynamic Test, typename Base, typename Value>
+requires impl::SharesTypeHierarchyWith<Test, Base>
+size_t count_isa(rtti_column<Base, Value> const& column) {
+    size_t const size = column.size();
+    auto const* data = column.data();
+    size_t result = 0;
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        result += (size_t)std::popcount(impl::columnIsaWord<Test>(data + i));
+    }
+    if (i < size) {
+        result += (size_t)std::popcount(
+            impl::columnIsaWordScalar<Test>(data + i, size - i));
+    }
+    return result;
+}
+
+/// Number of occurences of each type ID in a column, indexed by ID
+template <typename Base>
+using type_histogram_t = std::array<size_t, impl::TypeToBound<Base>>;
+
+/// \Returns the number of occurences of each type ID in \p column
+template <typename Base, typename Value>
+type_histogram_t<Base> type_histogram(rtti_column<Base, Value> const& column) {
+    /// We count into four interleaved tables so consecutive equal IDs don't
+    /// serialize on the same counter
+    constexpr size_t Count = impl::TypeToBound<Base>;
+    std::vector<std::uint32_t> partial(4 * Count);
+    size_t const size = column.size();
+    auto const* data = column.data();
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        ++partial[0 * Count + data[i + 0]];
+        ++partial[1 * Count + data[i + 1]];
+        ++partial[2 * Count + data[i + 2]];
+        ++partial[3 * Count + data[i + 3]];
+    }
+    for (; i < size; ++i) {
+        ++partial[data[i]];
+    }
+    type_histogram_t<Base> result{};
+    for (size_t ID = 0; ID < Count; ++ID) {
+        result[ID] = (size_t)partial[0 * Count + ID] + partial[1 * Count + ID] +
+                     partial[2 * Count + ID] + partial[3 * Count + ID];
+    }
+    return result;
+}
+
+/// Result of `partition_by_type`. `indices` is a permutation of the element
+/// indices of the column, grouped by type ID. Within each group the original
+/// order is preserved.
+template <typename Base>
+struct type_partition {
+    using id_type = impl::TypeToIDType<Base>;
+
+    /// \Returns the indices of all elements with runtime type \p ID
+    std::span<std::uint32_t const> of(id_type ID) const {
+        return std::span(indices).subspan(offsets[(size_t)ID],
+                                          offsets[(size_t)ID + 1] -
+                                              offsets[(size_t)ID]);
+    }
+
+    std::vector<std::uint32_t> indices;
+    std::array<size_t, impl::TypeToBound<Base> + 1> offsets{};
+};
+
+/// Stable counting sort of the element indices of \p column by type ID
+template <typename Base, typename Value>
+type_partition<Base>
+partition_by_type(rtti_column<Base, Value> const& column) {
+    constexpr size_t Count = impl::TypeToBound<Base>;
+    auto histogram = type_histogram(column);
+    type_partition<Base> result;
+    for (size_t ID = 0; ID < Count; ++ID) {
+        result.offsets[ID + 1] = result.offsets[ID] + histogram[ID];
+    }
+    size_t const size = column.size();
+    assert(size <= UINT32_MAX);
+    result.indices.resize(size);
+    auto next = result.offsets;
+    auto const* data = column.data();
+    for (size_t i = 0; i < size; ++i) {
+        result.indices[next[data[i]]++] = (std::uint32_t)i;
+    }
+    return result;
+}
+
+} // namespace csp
+
+#undef CSP_IMPL_COLUMN_SSE2
+#undef CSP_IMPL_COLUMN_AVX2
+
+#endif // CSP_COLUMN_HPP
@@ -0,0 +1,150 @@
+#ifndef CSP_INTERN_HPP
+#define CSP_INTERN_HPP
+
+#include <functional> // For std::hash
+#include <unordered_set>
+#include <vector>
+
+#include "../csp.hpp"
+
+/// # Interning
+///
+/// `intern_table` implements hash-consing for immutable objects of a class
+/// hierarchy: Structurally equal objects are replaced by one canonical
+/// instance owned by the table. If trees are interned bottom-up, the children
+/// of a node are canonical by the time the node itself is interned, so
+/// comparing two nodes only compares their own data and the addresses of
+/// their children, and equality of interned trees is pointer equality.
+
+namespace csp {
+
+/// Customization point for the hash of objects of type \p T used by
+/// `intern_table`. The default uses `std::hash<T>`. Specialize this for every
+/// concrete type that is interned and has no `std::hash` specialization.
+template <typename T>
+struct intern_hash {
+    size_t operator()(T const& object) const
+    requires requires { std::hash<T>{}(object); }
+    {
+        return std::hash<T>{}(object);
+    }
+};
+
+/// Customization point for the equality of objects of type \p T used by
+/// `intern_table`. The default uses `operator==`
+template <typename T>
+struct intern_equal {
+    bool operator()(T const& a, T const& b) const { return a == b; }
+};
+
+namespace impl {
+
+inline size_t hashCombine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+}
+
+/// Hashes objects of the hierarchy of \p Base by their dynamic type
+template <typename Base>
+struct InternHasher {
+    size_t operator()(Base const* object) const {
+        return csp::visit(*object, []<typename T>(T const& derived) {
+            return hashCombine((size_t)TypeToID<T>, intern_hash<T>{}(derived));
+        });
+    }
+};
+
+/// Compares objects of the hierarchy of \p Base. Objects of different dynamic
+/// types are never equal
+template <typename Base>
+struct InternEqual {
+    bool operator()(Base const* a, Base const* b) const {
+        if (get_rtti(*a) != get_rtti(*b)) {
+            return false;
+        }
+        return csp::visit(*a, *b,
+                          []<typename T, typename U>(T const& a, U const& b) {
+            if constexpr (std::is_same_v<T, U>) {
+                return intern_equal<T>{}(a, b);
+            }
+            else {
+                return false;
+            }
+        });
+    }
+};
+
+} // namespace impl
+
+/// Table of canonical instances of objects of the hierarchy of \p Base.
+/// Interned objects are owned by the table and stay valid until the table is
+/// cleared or destroyed. They must not be modified.
+template <impl::Dynamic Base>
+class intern_table {
+public:
+    /// \Returns the canonical instance of an object equal to \p object. If the
+    /// table has no such object yet, \p object is moved into the table
+    template <std::derived_from<Base> T>
+    requires std::is_move_constructible_v<T>
+    T const* intern(T object) {
+        if (auto* existing = find(object)) {
+            return static_cast<T const*>(existing);
+        }
+        return static_cast<T const*>(
+            insert(csp::make_unique<T>(std::move(object))));
+    }
+
+    /// \Returns the canonical instance of an object equal to `*object`. If the
+    /// table has no such object yet, the table takes ownership of \p object,
+    /// otherwise \p object is destroyed.
+    template <std::derived_from<Base> T>
+    T const* intern(csp::unique_ptr<T> object) {
+        if (auto* existing = find(*object)) {
+            return static_cast<T const*>(existing);
+        }
+        return static_cast<T const*>(insert(std::move(object)));
+    }
+
+    /// Constructs an object of type \p T from \p args... and interns it
+    template <std::derived_from<Base> T, typename... Args>
+    T const* make(Args&&... args) {
+        return intern(T((Args&&)args...));
+    }
+
+    /// \Returns the canonical instance of an object equal to \p object or
+    /// `nullptr` if there is none
+    Base const* find(Base const& object) const {
+        auto itr = _index.find(&object);
+        return itr != _index.end() ? *itr : nullptr;
+    }
+
+    /// \Returns `true` if \p object is the canonical instance of its value
+    bool is_canonical(Base const& object) const {
+        return find(object) == &object;
+    }
+
+    /// \Returns the number of canonical instances
+    size_t size() const { return _objects.size(); }
+
+    /// Destroys all canonical instances
+    void clear() {
+        _index.clear();
+        _objects.clear();
+    }
+
+private:
+    Base const* insert(csp::unique_ptr<Base> object) {
+        Base const* result = object.get();
+        _index.insert(result);
+        _objects.push_back(std::move(object));
+        return result;
+    }
+
+    std::unordered_set<Base const*, impl::InternHasher<Base>,
+                       impl::InternEqual<Base>>
+        _index;
+    std::vector<csp::unique_ptr<Base>> _objects;
+};
+
+} // namespace csp
+
+#endif // CSP_INTERN_HPP
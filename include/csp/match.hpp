@@ -0,0 +1,438 @@
+#ifndef CSP_MATCH_HPP
+#define CSP_MATCH_HPP
+
+#include <bit> // For std::countr_zero
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <tuple>
+
+#include "traverse.hpp"
+
+/// # Pattern matching
+///
+/// Patterns describe the shape of a subtree by the types of its nodes, e.g.
+///
+///     pattern<BinaryExpr>(child<0>(is<Literal>), child<1>(is<Literal>))
+///
+/// matches binary expressions whose operands are both literals. `match` tests a
+/// set of rules against a node in one pass. The patterns are compiled at
+/// compile time into one table per node position that maps the type ID of the
+/// node at that position to the set of rules that accept it. At runtime every
+/// position is read at most once, and positions that no remaining rule
+/// depends on are not read at all.
+
+namespace csp {
+
+namespace impl {
+
+/// Maximum number of rules in one call to `match`
+inline constexpr size_t MaxMatchRules = 64;
+
+/// Constraint on the type of the node at position `path` in a pattern. Built
+/// during constant evaluation only
+template <size_t NumIDs, size_t MaxDepth>
+struct PatternConstraint {
+    size_t path[MaxDepth + 1] = {};
+    size_t depth = 0;
+    size_t rule = 0;
+    bool pass[NumIDs] = {};
+};
+
+/// Matches nodes of type `T`
+template <typename T>
+struct IsPattern {
+    using Root = T;
+    static constexpr size_t NumConstraints = 1;
+    static constexpr size_t Depth = 0;
+
+    template <typename C>
+    static constexpr void collect(C* out, size_t& count, C prefix) {
+        for (size_t ID = 0; ID < TypeToBound<T>; ++ID) {
+            prefix.pass[ID] = IsaDispatchArray<T>[ID];
+        }
+        out[count++] = prefix;
+    }
+};
+
+/// Matches any node
+struct AnyPattern {
+    using Root = void;
+    static constexpr size_t NumConstraints = 1;
+    static constexpr size_t Depth = 0;
+
+    template <typename C>
+    static constexpr void collect(C* out, size_t& count, C prefix) {
+        for (bool& pass : prefix.pass) {
+            pass = true;
+        }
+        out[count++] = prefix;
+    }
+};
+
+template <size_t Index, typename P>
+struct ChildPattern;
+
+template <typename T>
+struct IsChildPattern: std::false_type {};
+
+template <size_t Index, typename P>
+struct IsChildPattern<ChildPattern<Index, P>>: std::true_type {};
+
+/// Matches if child \p Index matches \p P. If \p P is itself a child
+/// pattern, the intermediate position is constrained to exist so that it is
+/// part of the path table
+template <size_t Index, typename P>
+struct ChildPattern {
+    static constexpr size_t NumConstraints =
+        P::NumConstraints + IsChildPattern<P>::value;
+    static constexpr size_t Depth = P::Depth + 1;
+
+    template <typename C>
+    static constexpr void collect(C* out, size_t& count, C prefix) {
+        prefix.path[prefix.depth++] = Index;
+        if constexpr (IsChildPattern<P>::value) {
+            AnyPattern::collect(out, count, prefix);
+        }
+        P::collect(out, count, prefix);
+    }
+};
+
+/// Matches nodes of type \p T whose children match \p Children...
+template <typename T, typename... Children>
+struct NodePattern {
+    static_assert((IsChildPattern<Children>::value && ...),
+                  "Subpatterns must be child patterns");
+
+    using Root = T;
+    static constexpr size_t NumConstraints =
+        (1 + ... + Children::NumConstraints);
+    static constexpr size_t Depth = Max<0, Children::Depth...>;
+
+    template <typename C>
+    static constexpr void collect(C* out, size_t& count, C prefix) {
+        IsPattern<T>::collect(out, count, prefix);
+        (Children::collect(out, count, prefix), ...);
+    }
+};
+
+template <typename P, typename H>
+struct MatchRule {
+    using Pattern = P;
+    H handler;
+};
+
+/// Rule table of a set of patterns. `Paths` lists all positions that appear in
+/// the patterns in lexicographical order, so every position comes after its
+/// parent.
+template <typename Node, typename... Patterns>
+struct CompiledPatterns {
+    static_assert(sizeof...(Patterns) <= MaxMatchRules, "Too many rules");
+
+    static constexpr size_t NumIDs = TypeToBound<Node>;
+    static constexpr size_t MaxDepth = Max<0, Patterns::Depth...>;
+    static constexpr size_t NumConstraints = (Patterns::NumConstraints + ...);
+    static constexpr std::uint64_t AllRules =
+        ~std::uint64_t(0) >> (MaxMatchRules - sizeof...(Patterns));
+
+    using Constraint = PatternConstraint<NumIDs, MaxDepth>;
+
+    static constexpr Array<Constraint, NumConstraints> Constraints = [] {
+        Array<Constraint, NumConstraints> result{};
+        size_t count = 0, rule = 0;
+        (
+            [&] {
+            Constraint prefix{};
+            prefix.rule = rule++;
+            Patterns::collect(result.elems, count, prefix);
+        }(),
+            ...);
+        return result;
+    }();
+
+    /// Lexicographical comparison of the paths of \p a and \p b
+    static constexpr int comparePaths(Constraint const& a,
+                                      Constraint const& b) {
+        for (size_t i = 0; i < a.depth && i < b.depth; ++i) {
+            if (a.path[i] != b.path[i]) {
+                return a.path[i] < b.path[i] ? -1 : 1;
+            }
+        }
+        return a.depth == b.depth ? 0 : (a.depth < b.depth ? -1 : 1);
+    }
+
+    /// `true` if the path of \p prefix is a prefix of the path of \p path
+    static constexpr bool isPrefix(Constraint const& prefix,
+                                   Constraint const& path) {
+        if (prefix.depth > path.depth) {
+            return false;
+        }
+        for (size_t i = 0; i < prefix.depth; ++i) {
+            if (prefix.path[i] != path.path[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Constraints sorted by path
+    static constexpr Array<Constraint, NumConstraints> Sorted = [] {
+        auto result = Constraints;
+        for (size_t i = 1; i < NumConstraints; ++i) {
+            for (size_t j = i; j > 0 && comparePaths(result[j - 1],
+                                                     result[j]) > 0;
+                 --j)
+            {
+                auto tmp = result[j];
+                result[j] = result[j - 1];
+                result[j - 1] = tmp;
+            }
+        }
+        return result;
+    }();
+
+    static constexpr size_t NumPaths = [] {
+        size_t count = 1;
+        for (size_t i = 1; i < NumConstraints; ++i) {
+            count += comparePaths(Sorted[i - 1], Sorted[i]) != 0;
+        }
+        return count;
+    }();
+
+    struct PathInfo {
+        /// Index of the parent position in `Paths`
+        size_t parent = 0;
+
+        /// Index of this position among the children of the parent
+        size_t index = 0;
+
+        /// Rules that constrain this position or any position below it. These
+        /// rules fail if there is no node at this position
+        std::uint64_t need = 0;
+
+        /// Maps the type ID of the node at this position to the rules that
+        /// accept it
+        std::uint64_t accept[NumIDs] = {};
+    };
+
+    static constexpr Array<PathInfo, NumPaths> Paths = [] {
+        Array<PathInfo, NumPaths> result{};
+        Array<size_t, NumPaths> first{}; // Index into `Sorted`
+        for (size_t i = 0, p = 0; i < NumConstraints; ++i) {
+            if (i > 0 && comparePaths(Sorted[i - 1], Sorted[i]) != 0) {
+                ++p;
+            }
+            if (i == 0 || comparePaths(Sorted[i - 1], Sorted[i]) != 0) {
+                first[p] = i;
+            }
+        }
+        for (size_t p = 0; p < NumPaths; ++p) {
+            auto& info = result[p];
+            auto const& path = Sorted[first[p]];
+            for (size_t ID = 0; ID < NumIDs; ++ID) {
+                info.accept[ID] = AllRules;
+            }
+            for (size_t i = 0; i < NumConstraints; ++i) {
+                auto const& c = Sorted[i];
+                std::uint64_t bit = std::uint64_t(1) << c.rule;
+                if (isPrefix(path, c)) {
+                    info.need |= bit;
+                }
+                if (comparePaths(path, c) != 0) {
+                    continue;
+                }
+                for (size_t ID = 0; ID < NumIDs; ++ID) {
+                    if (!c.pass[ID]) {
+                        info.accept[ID] &= ~bit;
+                    }
+                }
+            }
+            if (path.depth == 0) {
+                continue;
+            }
+            info.index = path.path[path.depth - 1];
+            /// The parent is the closest preceding path of depth - 1 that is a
+            /// prefix of this path
+            for (size_t q = p; q-- > 0;) {
+                auto const& candidate = Sorted[first[q]];
+                if (candidate.depth + 1 == path.depth &&
+                    isPrefix(candidate, path))
+                {
+                    info.parent = q;
+                    break;
+                }
+            }
+        }
+        return result;
+    }();
+};
+
+/// \Returns a pointer to the child at \p index of \p parent or `nullptr` if
+/// there is no such child
+template <typename Node, typename Children>
+Node* matchChildAt(Children& children, Node& parent, size_t index) {
+    auto&& range = std::invoke(children, parent);
+    auto itr = std::ranges::begin(range);
+    auto const end = std::ranges::end(range);
+    if constexpr (std::ranges::sized_range<decltype(range)> &&
+                  std::ranges::random_access_range<decltype(range)>)
+    {
+        if (index >= (size_t)std::ranges::size(range)) {
+            return nullptr;
+        }
+        itr += (std::ptrdiff_t)index;
+    }
+    else {
+        for (; index > 0 && itr != end; --index) {
+            ++itr;
+        }
+        if (itr == end) {
+            return nullptr;
+        }
+    }
+    auto&& elem = *itr;
+    if (isNullElement(elem)) {
+        return nullptr;
+    }
+    return &static_cast<Node&>(derefElement(elem));
+}
+
+/// \Returns the index of the first of \p Patterns that matches \p root or
+/// `sizeof...(Patterns)` if none matches
+template <typename Node, typename... Patterns, typename Children>
+size_t matchIndex(Node& root, Children& children) {
+    using Compiled = CompiledPatterns<std::remove_cv_t<Node>, Patterns...>;
+    constexpr auto const& Paths = Compiled::Paths;
+    Node* nodes[Compiled::NumPaths] = { &root };
+    std::uint64_t candidates =
+        Paths[0].accept[(size_t)get_rtti(root)] & Compiled::AllRules;
+    for (size_t p = 1; p < Compiled::NumPaths && candidates; ++p) {
+        auto const& info = Paths[p];
+        if (!(candidates & info.need)) {
+            /// No remaining rule looks at this position or below
+            nodes[p] = nullptr;
+            continue;
+        }
+        Node* parent = nodes[info.parent];
+        Node* node =
+            parent ? matchChildAt(children, *parent, info.index) : nullptr;
+        nodes[p] = node;
+        if (!node) {
+            candidates &= ~info.need;
+            continue;
+        }
+        candidates &= info.accept[(size_t)get_rtti(*node)];
+    }
+    if (!candidates) {
+        return sizeof...(Patterns);
+    }
+    return (size_t)std::countr_zero(candidates);
+}
+
+/// Type the handler of a rule with pattern \p P is invoked with
+template <typename Node, typename P>
+using MatchRootType =
+    std::conditional_t<std::is_void_v<typename P::Root>, Node,
+                       copy_cvref_t<Node, typename P::Root>>;
+
+} // namespace impl
+
+/// Pattern that matches nodes of type \p T
+template <impl::Dynamic T>
+inline constexpr impl::IsPattern<T> is{};
+
+/// Pattern that matches any node
+inline constexpr impl::AnyPattern any_node{};
+
+/// Pattern that matches if the child at position \p Index exists and matches
+/// \p P. Can only be used as a subpattern of `pattern()` or of another
+/// `child()`, e.g. `child<0>(child<1>(is<T>))` matches if the second child of
+/// the first child is a `T`
+template <size_t Index, typename P>
+constexpr impl::ChildPattern<Index, P> child(P) {
+    return {};
+}
+
+/// Pattern that matches nodes of type \p T whose children match \p children...
+template <impl::Dynamic T, typename... Children>
+constexpr impl::NodePattern<T, Children...> pattern(Children...) {
+    return {};
+}
+
+/// Pairs the pattern \p P with the function \p handler that is invoked if the
+/// pattern matches. \p handler is invoked with the matched node cast to the
+/// type of the root of the pattern.
+template <typename P, typename H>
+constexpr impl::MatchRule<P, std::decay_t<H>> rule(P, H&& handler) {
+    return { (H&&)handler };
+}
+
+/// Tests \p rules... against \p node in order and invokes the handler of the
+/// first rule that matches. \p children is invoked with a node and must return
+/// a range of its children as pointers, smart pointers or references.
+///
+/// \Returns `true` if a rule matched if all handlers return `void`, otherwise
+/// a `std::optional` of the common result type of the handlers that is empty
+/// if no rule matched
+template <impl::Dynamic Root, typename Children, typename... Rules>
+requires(sizeof...(Rules) > 0)
+auto match(Root& node, Children&& children, Rules&&... rules) {
+    using Node = impl::TraversalNodeType<Root, Children>;
+    using RuleList = std::tuple<std::remove_cvref_t<Rules>...>;
+    using HandlerResults =
+        std::tuple<std::invoke_result_t<
+            decltype(std::remove_cvref_t<Rules>::handler)&,
+            impl::MatchRootType<Node, typename std::remove_cvref_t<
+                                          Rules>::Pattern>&>...>;
+    constexpr bool AllVoid = []<size_t... I>(std::index_sequence<I...>) {
+        return (std::is_void_v<std::tuple_element_t<I, HandlerResults>> &&
+                ...);
+    }(std::index_sequence_for<Rules...>{});
+    size_t const index =
+        impl::matchIndex<Node,
+                         typename std::remove_cvref_t<Rules>::Pattern...>(
+            node, children);
+    auto invoke = [&]<size_t I>(std::integral_constant<size_t, I>,
+                                auto& rule) -> decltype(auto) {
+        using P = typename std::tuple_element_t<I, RuleList>::Pattern;
+        using Target = impl::MatchRootType<Node, P>;
+        return std::invoke(rule.handler, static_cast<Target&>(node));
+    };
+    if constexpr (AllVoid) {
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            ((index == I ? (invoke(std::integral_constant<size_t, I>{}, rules),
+                            true)
+                         : false) ||
+             ...);
+        }(std::index_sequence_for<Rules...>{});
+        return index != sizeof...(Rules);
+    }
+    else {
+        using Result = std::common_type_t<std::invoke_result_t<
+            decltype(std::remove_cvref_t<Rules>::handler)&,
+            impl::MatchRootType<Node, typename std::remove_cvref_t<
+                                          Rules>::Pattern>&>...>;
+        std::optional<Result> result;
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            ((index == I ? (result.emplace(invoke(
+                                std::integral_constant<size_t, I>{}, rules)),
+                            true)
+                         : false) ||
+             ...);
+        }(std::index_sequence_for<Rules...>{});
+        return result;
+    }
+}
+
+/// \Returns `true` if \p node matches the pattern \p P
+template <impl::Dynamic Root, typename Children, typename P>
+bool matches(Root& node, Children&& children, P) {
+    using Node = impl::TraversalNodeType<Root, Children>;
+    return impl::matchIndex<Node, P>(node, children) == 0;
+}
+
+} // namespace csp
+
+#endif // CSP_MATCH_HPP
@@ -0,0 +1,125 @@
+#ifndef CSP_MEMO_HPP
+#define CSP_MEMO_HPP
+
+#include <algorithm> // For std::find
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "../csp.hpp"
+
+/// # Memoized visitation
+///
+/// `memo_visitor` caches the result of visiting a node in a side table keyed by
+/// the address of the node. Visitors recurse into children through the memo,
+/// which records which results depend on which. When a node is mutated,
+/// `mark_dirty` invalidates its result and the results of all nodes that were
+/// computed from it, so the next query recomputes only the dirty paths.
+
+namespace csp {
+
+/// Cache of the results of visiting nodes of the hierarchy of \p Node. Results
+/// are of type \p Result.
+template <impl::Dynamic Node, typename Result>
+class memo_visitor {
+    using Key = std::remove_cv_t<Node> const*;
+
+public:
+    /// Counts cache hits and misses of `visit`
+    struct statistics {
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+
+    /// \Returns the cached result for \p node. If there is none, \p node is
+    /// dispatched to \p f through `csp::visit` and the result is cached.
+    ///
+    /// Calls to `visit` made by \p f are recorded as dependencies: If the
+    /// result of a node is invalidated, the results of all nodes whose
+    /// computation queried it are invalidated as well.
+    ///
+    /// The returned reference is valid until the result is invalidated.
+    template <typename F>
+    Result const& visit(Node& node, F&& f) {
+        auto& entry = _entries[&node];
+        if (!_active.empty()) {
+            addDependent(entry, _active.back());
+        }
+        if (entry.value) {
+            ++_stats.hits;
+            return *entry.value;
+        }
+        ++_stats.misses;
+        _active.push_back(&node);
+        struct PopGuard {
+            std::vector<Key>& active;
+            ~PopGuard() { active.pop_back(); }
+        } guard{ _active };
+        /// `std::unordered_map` never moves its elements, so `entry` stays
+        /// valid while the recursive calls insert more entries
+        entry.value.emplace(csp::visit(node, f));
+        return *entry.value;
+    }
+
+    /// Invalidates the cached result of \p node and of all nodes that depend
+    /// on it
+    void mark_dirty(Node const& node) {
+        std::vector<Key> worklist = { &node };
+        while (!worklist.empty()) {
+            Key key = worklist.back();
+            worklist.pop_back();
+            auto itr = _entries.find(key);
+            if (itr == _entries.end() || !itr->second.value) {
+                continue;
+            }
+            auto& entry = itr->second;
+            entry.value.reset();
+            worklist.insert(worklist.end(), entry.dependents.begin(),
+                            entry.dependents.end());
+        }
+    }
+
+    /// Invalidates the results depending on \p node and removes \p node from
+    /// the cache. Must be called before a cached node is destroyed.
+    void forget(Node const& node) {
+        mark_dirty(node);
+        _entries.erase(&node);
+    }
+
+    /// \Returns `true` if a valid result for \p node is cached
+    bool is_cached(Node const& node) const {
+        auto itr = _entries.find(&node);
+        return itr != _entries.end() && itr->second.value;
+    }
+
+    /// Removes all cached results
+    void clear() { _entries.clear(); }
+
+    /// \Returns the hit and miss counts since construction or the last call to
+    /// `reset_stats()`
+    statistics const& stats() const { return _stats; }
+
+    /// Resets the hit and miss counts to zero
+    void reset_stats() { _stats = {}; }
+
+private:
+    struct Entry {
+        std::optional<Result> value;
+        std::vector<Key> dependents;
+    };
+
+    static void addDependent(Entry& entry, Key dependent) {
+        auto& deps = entry.dependents;
+        if (std::find(deps.begin(), deps.end(), dependent) == deps.end()) {
+            deps.push_back(dependent);
+        }
+    }
+
+    std::unordered_map<Key, Entry> _entries;
+    std::vector<Key> _active;
+    statistics _stats;
+};
+
+} // namespace csp
+
+#endif // CSP_MEMO_HPP
@@ -0,0 +1,595 @@
+#ifndef CSP_PARALLEL_HPP
+#define CSP_PARALLEL_HPP
+
+#include <algorithm> // For std::min
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+#include "batch.hpp"
+#include "traverse.hpp"
+
+/// # Parallel visitation
+///
+/// This file provides a small work-stealing thread pool and parallel versions
+/// of the batch visitation algorithms. Like `visit_batch`, the parallel
+/// algorithms group the elements by runtime type before they are distributed
+/// to the workers, so every task is a monomorphic loop over objects of one
+/// concrete type.
+
+namespace csp {
+
+class work_stealing_pool;
+
+/// Counts the outstanding tasks spawned into it and stores the first exception
+/// thrown by any of them
+class task_group {
+public:
+    task_group() = default;
+    task_group(task_group const&) = delete;
+    task_group& operator=(task_group const&) = delete;
+
+    /// \Returns `true` if all tasks spawned into this group have completed
+    bool done() const noexcept {
+        return _pending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class work_stealing_pool;
+
+    void setException(std::exception_ptr e) {
+        std::lock_guard lock(_mutex);
+        if (!_exception) {
+            _exception = std::move(e);
+        }
+    }
+
+    std::atomic<size_t> _pending = 0;
+    std::mutex _mutex;
+    std::exception_ptr _exception;
+};
+
+/// Thread pool where every worker owns a task deque. Workers push and pop
+/// their own tasks at the back of their deque and steal from the front of the
+/// other workers' deques when they run out of work.
+///
+/// A pool with `num_threads` threads spawns `num_threads - 1` background
+/// threads. The thread that calls `wait()` executes tasks as well, so nested
+/// spawning from within tasks cannot deadlock.
+class work_stealing_pool {
+public:
+    /// Creates a pool that runs tasks on \p numThreads threads
+    explicit work_stealing_pool(
+        size_t numThreads = std::thread::hardware_concurrency()):
+        _queues(numThreads > 0 ? numThreads : 1) {
+        for (size_t i = 1; i < _queues.size(); ++i) {
+            _threads.emplace_back([this, i] { workerMain(i); });
+        }
+    }
+
+    work_stealing_pool(work_stealing_pool const&) = delete;
+    work_stealing_pool& operator=(work_stealing_pool const&) = delete;
+
+    ~work_stealing_pool() {
+        {
+            std::lock_guard lock(_sleepMutex);
+            _stop = true;
+        }
+        _sleepCV.notify_all();
+        for (auto& thread : _threads) {
+            thread.join();
+        }
+    }
+
+    /// \Returns the number of threads that execute tasks, including the
+    /// waiting thread
+    size_t num_threads() const noexcept { return _queues.size(); }
+
+    /// \Returns the index of the calling thread in `[0, num_threads())`.
+    /// Threads that are not workers of this pool have index 0, so only one
+    /// such thread may use the pool. It becomes the owner of the pool the
+    /// first time it calls into it, and in debug builds use from any other
+    /// thread that is not a worker fails an assertion. Create one pool per
+    /// external thread to run parallel algorithms from multiple threads.
+    size_t this_thread_index() const noexcept {
+        if (currentPool() == this) {
+            return currentIndex();
+        }
+#ifndef NDEBUG
+        std::thread::id owner{};
+        if (!_owner.compare_exchange_strong(owner,
+                                            std::this_thread::get_id())) {
+            assert(owner == std::this_thread::get_id() &&
+                   "Pool is used by more than one external thread");
+        }
+#endif
+        return 0;
+    }
+
+    /// Schedules \p task to run on any thread of the pool as part of \p group
+    void spawn(task_group& group, std::function<void()> task) {
+        auto& queue = _queues[this_thread_index()];
+        {
+            std::lock_guard lock(queue.mutex);
+            push(queue, group, std::move(task));
+        }
+        {
+            std::lock_guard lock(_sleepMutex);
+        }
+        _sleepCV.notify_one();
+    }
+
+    /// Schedules `fn(i)` for every `i` in `[0, count)` as part of \p group.
+    /// The indices are split into contiguous ranges, one per thread, that are
+    /// pushed directly into the deques of the threads, so the threads start on
+    /// separate parts of the work and only steal once they run out. \p fn is
+    /// referenced by the tasks and must stay alive until \p group is waited
+    /// for, also if this function throws.
+    template <typename F>
+    void spawn_n(task_group& group, size_t count, F const& fn) {
+        size_t const numQueues = _queues.size();
+        for (size_t q = 0; q < numQueues; ++q) {
+            size_t const begin = count * q / numQueues;
+            size_t const end = count * (q + 1) / numQueues;
+            auto& queue = _queues[q];
+            std::lock_guard lock(queue.mutex);
+            for (size_t i = begin; i < end; ++i) {
+                push(queue, group, [&fn, i] { fn(i); });
+            }
+        }
+        {
+            std::lock_guard lock(_sleepMutex);
+        }
+        _sleepCV.notify_all();
+    }
+
+    /// Executes tasks until all tasks of \p group have completed. Sleeps while
+    /// there is nothing to run and tasks of \p group are still running on
+    /// other threads. Rethrows the first exception thrown by a task of
+    /// \p group.
+    void wait(task_group& group) {
+        size_t const index = this_thread_index();
+        while (!group.done()) {
+            if (runOne(index)) {
+                continue;
+            }
+            std::unique_lock lock(_sleepMutex);
+            _sleepCV.wait(lock, [&] {
+                return group.done() ||
+                       _numQueued.load(std::memory_order_acquire) > 0;
+            });
+        }
+        if (group._exception) {
+            std::rethrow_exception(std::exchange(group._exception, nullptr));
+        }
+    }
+
+private:
+    struct Task {
+        std::function<void()> function;
+        task_group* group;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    static work_stealing_pool*& currentPool() noexcept {
+        thread_local work_stealing_pool* pool = nullptr;
+        return pool;
+    }
+
+    static size_t& currentIndex() noexcept {
+        thread_local size_t index = 0;
+        return index;
+    }
+
+    /// Appends \p task to \p queue, whose mutex must be held. The counters are
+    /// incremented after the task is in the queue, so they stay exact if
+    /// pushing throws, and before any other thread can take the task
+    void push(Queue& queue, task_group& group, std::function<void()> task) {
+        queue.tasks.push_back(Task{ std::move(task), &group });
+        group._pending.fetch_add(1, std::memory_order_relaxed);
+        _numQueued.fetch_add(1, std::memory_order_release);
+    }
+
+    std::optional<Task> popOwn(size_t index) {
+        auto& queue = _queues[index];
+        std::lock_guard lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return std::nullopt;
+        }
+        Task task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return task;
+    }
+
+    std::optional<Task> steal(size_t thief) {
+        for (size_t i = 1; i < _queues.size(); ++i) {
+            auto& queue = _queues[(thief + i) % _queues.size()];
+            std::lock_guard lock(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            Task task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return task;
+        }
+        return std::nullopt;
+    }
+
+    /// Runs one task from the own queue or a stolen one. \Returns `false` if
+    /// no task was found
+    bool runOne(size_t index) {
+        auto task = popOwn(index);
+        if (!task) {
+            task = steal(index);
+        }
+        if (!task) {
+            return false;
+        }
+        _numQueued.fetch_sub(1, std::memory_order_relaxed);
+        try {
+            task->function();
+        }
+        catch (...) {
+            task->group->setException(std::current_exception());
+        }
+        if (task->group->_pending.fetch_sub(1, std::memory_order_acq_rel) ==
+            1)
+        {
+            /// Wake up threads that are waiting for the group
+            {
+                std::lock_guard lock(_sleepMutex);
+            }
+            _sleepCV.notify_all();
+        }
+        return true;
+    }
+
+    void workerMain(size_t index) {
+        currentPool() = this;
+        currentIndex() = index;
+        while (true) {
+            if (runOne(index)) {
+                continue;
+            }
+            std::unique_lock lock(_sleepMutex);
+            _sleepCV.wait(lock, [&] {
+                return _stop ||
+                       _numQueued.load(std::memory_order_acquire) > 0;
+            });
+            if (_stop) {
+                return;
+            }
+        }
+    }
+
+    std::vector<Queue> _queues;
+    std::vector<std::thread> _threads;
+    std::atomic<size_t> _numQueued = 0;
+    std::mutex _sleepMutex;
+    std::condition_variable _sleepCV;
+    bool _stop = false;
+#ifndef NDEBUG
+    /// The only thread that is not a worker and uses the pool
+    mutable std::atomic<std::thread::id> _owner{};
+#endif
+};
+
+/// \Returns a process wide pool with one thread per hardware thread
+inline work_stealing_pool& default_pool() {
+    static work_stealing_pool pool;
+    return pool;
+}
+
+/// Options for the parallel algorithms
+struct parallel_options {
+    /// The pool to run on. If null, `default_pool()` is used
+    work_stealing_pool* pool = nullptr;
+
+    /// Maximum number of elements processed by one task
+    size_t grain_size = 4096;
+
+    /// Used by `parallel_traverse`: Children of nodes with a depth less than
+    /// this value are spawned as separate tasks. Deeper subtrees are traversed
+    /// sequentially by the task that reached them.
+    size_t spawn_depth = 16;
+};
+
+/// Holds one instance of `T` per thread of a `work_stealing_pool`. Tasks can
+/// accumulate into `local()` without synchronization. Instances are padded to
+/// avoid false sharing. The instance with index 0 belongs to the owner thread
+/// of the pool, see `work_stealing_pool::this_thread_index()`.
+template <typename T>
+class per_thread {
+public:
+    explicit per_thread(work_stealing_pool& pool = default_pool(),
+                        T const& init = T{}):
+        _pool(&pool), _slots(pool.num_threads(), Slot{ init }) {}
+
+    /// \Returns the instance of the calling thread
+    T& local() { return _slots[_pool->this_thread_index()].value; }
+
+    /// \Returns the number of instances, i.e. the number of threads
+    size_t size() const noexcept { return _slots.size(); }
+
+    /// \Returns the instance of the thread with index \p index
+    /// @{
+    T& operator[](size_t index) { return _slots[index].value; }
+    T const& operator[](size_t index) const { return _slots[index].value; }
+    /// @}
+
+    /// Folds all instances with \p combine in thread index order
+    template <typename Combine>
+    T combine(Combine&& combine) const {
+        T result = _slots[0].value;
+        for (size_t i = 1; i < _slots.size(); ++i) {
+            result = combine(std::move(result), _slots[i].value);
+        }
+        return result;
+    }
+
+private:
+    struct alignas(64) Slot {
+        T value;
+    };
+
+    work_stealing_pool* _pool;
+    std::vector<Slot> _slots;
+};
+
+namespace impl {
+
+/// A homogeneous slice `[begin, end)` of the type sorted index array of a
+/// `type_partition`
+struct ParallelChunk {
+    size_t begin, end;
+};
+
+/// Splits every type bucket of \p partition into chunks of at most
+/// \p grainSize elements. Chunk boundaries depend only on the input and
+/// \p grainSize, never on the number of threads.
+template <typename Base>
+std::vector<ParallelChunk>
+makeParallelChunks(type_partition<Base> const& partition, size_t grainSize) {
+    assert(grainSize > 0);
+    std::vector<ParallelChunk> chunks;
+    for (size_t ID = 0; ID + 1 < partition.offsets.size(); ++ID) {
+        size_t const end = partition.offsets[ID + 1];
+        for (size_t begin = partition.offsets[ID]; begin < end;
+             begin += grainSize) {
+            chunks.push_back({ begin, std::min(begin + grainSize, end) });
+        }
+    }
+    return chunks;
+}
+
+/// Dispatches once on the type of the homogeneous \p chunk and then invokes
+/// `fn(Derived& object)` for every object in it
+template <typename Obj, typename Base, typename F>
+void forEachInChunk(std::vector<Obj*> const& objects,
+                    type_partition<Base> const& partition, ParallelChunk chunk,
+                    F&& fn) {
+    auto const* indices = partition.indices.data();
+    csp::visit(*objects[indices[chunk.begin]], [&]<typename Derived>(Derived&) {
+        for (size_t i = chunk.begin; i < chunk.end; ++i) {
+            fn(static_cast<Derived&>(*objects[indices[i]]));
+        }
+    });
+}
+
+/// Runs `chunkFn(index, chunks[index])` for every chunk as a task on the pool
+/// selected by \p options. The chunks are distributed over the deques of all
+/// threads of the pool
+template <typename F>
+void runParallelChunks(std::vector<ParallelChunk> const& chunks,
+                       parallel_options const& options, F&& chunkFn) {
+    auto& pool = options.pool ? *options.pool : default_pool();
+    task_group group;
+    auto task = [&](size_t i) { chunkFn(i, chunks[i]); };
+    std::exception_ptr exception;
+    try {
+        pool.spawn_n(group, chunks.size(), task);
+    }
+    catch (...) {
+        exception = std::current_exception();
+    }
+    /// Tasks that were spawned before an exception refer to `task`, so we
+    /// must wait for them in any case
+    try {
+        pool.wait(group);
+    }
+    catch (...) {
+        if (!exception) {
+            exception = std::current_exception();
+        }
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+} // namespace impl
+
+/// Invokes \p f on every element of \p range with the element's most derived
+/// type, like `visit_batch`, but distributes the work over the threads of a
+/// work-stealing pool. Elements are grouped by type and every task processes
+/// up to `options.grain_size` elements of the same concrete type.
+///
+/// \p f is invoked concurrently and must be safe to call from multiple
+/// threads.
+template <std::ranges::input_range R, typename F>
+requires impl::Dynamic<impl::RangeObjectType<R>>
+void parallel_visit(R&& range, F&& f, parallel_options const& options = {}) {
+    using Obj = impl::RangeObjectType<R>;
+    std::vector<Obj*> objects;
+    rtti_column<std::remove_cv_t<Obj>> column;
+    impl::gatherBatch<Obj>(range, objects, column);
+    auto partition = partition_by_type(column);
+    auto chunks = impl::makeParallelChunks(partition, options.grain_size);
+    impl::runParallelChunks(chunks, options,
+                            [&](size_t, impl::ParallelChunk chunk) {
+        impl::forEachInChunk(objects, partition, chunk,
+                             [&](auto& object) { f(object); });
+    });
+}
+
+/// Invokes \p f on every element of \p range in parallel like
+/// `parallel_visit` and reduces the results with \p combine.
+///
+/// Every task folds the results of its chunk into a partial result. The
+/// partial results are combined after all tasks have completed, in an order
+/// that only depends on the input and `options.grain_size`, so the result is
+/// reproducible regardless of thread count and scheduling. Elements are
+/// combined in type grouped order, so \p combine should be associative and
+/// commutative.
+///
+/// \Returns the reduced result or a value initialized result if \p range is
+/// empty
+template <std::ranges::input_range R, typename F, typename Combine>
+requires impl::Dynamic<impl::RangeObjectType<R>>
+auto parallel_visit_reduce(R&& range, F&& f, Combine&& combine,
+                           parallel_options const& options = {}) {
+    using Obj = impl::RangeObjectType<R>;
+    using Result =
+        std::decay_t<decltype(csp::visit(std::declval<Obj&>(), (F&&)f))>;
+    std::vector<Obj*> objects;
+    rtti_column<std::remove_cv_t<Obj>> column;
+    impl::gatherBatch<Obj>(range, objects, column);
+    auto partition = partition_by_type(column);
+    auto chunks = impl::makeParallelChunks(partition, options.grain_size);
+    std::vector<std::optional<Result>> partials(chunks.size());
+    impl::runParallelChunks(chunks, options,
+                            [&](size_t index, impl::ParallelChunk chunk) {
+        auto& partial = partials[index];
+        impl::forEachInChunk(objects, partition, chunk, [&](auto& object) {
+            if (partial) {
+                *partial = combine(std::move(*partial), f(object));
+            }
+            else {
+                partial.emplace(f(object));
+            }
+        });
+    });
+    std::optional<Result> result;
+    for (auto& partial : partials) {
+        if (!result) {
+            result = std::move(partial);
+        }
+        else {
+            *result = combine(std::move(*result), std::move(*partial));
+        }
+    }
+    return result ? std::move(*result) : Result{};
+}
+
+namespace impl {
+
+template <typename Node, typename Children, typename Pre, typename Post>
+struct ParallelTraversal {
+    work_stealing_pool& pool;
+    Children& children;
+    Pre& pre;
+    Post& post;
+    size_t spawnDepth;
+
+    void run(Node& node, size_t depth) {
+        csp::visit(node, pre);
+        if (depth < spawnDepth) {
+            /// We spawn all children but the last one and continue with the
+            /// last one on this thread
+            task_group group;
+            std::exception_ptr exception;
+            try {
+                Node* last = nullptr;
+                for (auto&& elem : children(node)) {
+                    if (isNullElement(elem)) {
+                        continue;
+                    }
+                    if (last) {
+                        pool.spawn(group, [this, last, depth] {
+                            run(*last, depth + 1);
+                        });
+                    }
+                    last = &static_cast<Node&>(derefElement(elem));
+                }
+                if (last) {
+                    run(*last, depth + 1);
+                }
+            }
+            catch (...) {
+                exception = std::current_exception();
+            }
+            /// The spawned tasks refer to `group` and `this`, so we must wait
+            /// for them even if this thread threw
+            try {
+                pool.wait(group);
+            }
+            catch (...) {
+                if (!exception) {
+                    exception = std::current_exception();
+                }
+            }
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+        else {
+            for (auto&& elem : children(node)) {
+                if (!isNullElement(elem)) {
+                    run(derefElement(elem), depth + 1);
+                }
+            }
+        }
+        csp::visit(node, post);
+    }
+};
+
+} // namespace impl
+
+/// Traverses the tree rooted at \p root in parallel. \p children is invoked
+/// with a node and must return a range of its children as pointers, smart
+/// pointers or references. Every node is dispatched through `csp::visit` to
+/// \p pre before its children are traversed and to \p post after all of its
+/// children have been traversed.
+///
+/// Children of nodes with a depth less than `options.spawn_depth` are
+/// traversed as separate tasks on the work-stealing pool, deeper subtrees are
+/// traversed sequentially. Sibling subtrees are traversed concurrently, so the
+/// hooks must be thread safe. Use `per_thread` to accumulate results without
+/// synchronization.
+/// @{
+template <impl::Dynamic Root, typename Children, typename Pre,
+          typename Post = impl::NoOpVisitor>
+requires(!std::is_same_v<std::remove_cvref_t<Post>, parallel_options>)
+void parallel_traverse(Root& root, Children&& children, Pre&& pre,
+                       Post&& post = {}, parallel_options const& options = {}) {
+    using Node = impl::TraversalNodeType<Root, Children>;
+    impl::ParallelTraversal<Node, std::remove_reference_t<Children>,
+                            std::remove_reference_t<Pre>,
+                            std::remove_reference_t<Post>>
+        traversal{ options.pool ? *options.pool : default_pool(), children,
+                   pre, post, options.spawn_depth };
+    traversal.run(root, 0);
+}
+
+template <impl::Dynamic Root, typename Children, typename Pre>
+void parallel_traverse(Root& root, Children&& children, Pre&& pre,
+                       parallel_options const& options) {
+    parallel_traverse(root, children, pre, impl::NoOpVisitor{}, options);
+}
+/// @}
+
+} // namespace csp
+
+#endif // CSP_PARALLEL_HPP
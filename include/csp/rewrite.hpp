@@ -0,0 +1,266 @@
+#ifndef CSP_REWRITE_HPP
+#define CSP_REWRITE_HPP
+
+#include <algorithm> // For std::reverse
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory> // For std::to_address
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../csp.hpp"
+
+/// # Tree rewriting
+///
+/// `rewriter` applies a set of rewrite rules to a tree until no rule applies
+/// anymore. Rules are registered for concrete or abstract node types. The set
+/// of rules that can apply to each type ID is computed at compile time, so
+/// nodes without applicable rules are skipped with one table lookup. After the
+/// initial bottom-up sweep, only nodes created by a rewrite and the parents of
+/// rewritten nodes are revisited.
+
+namespace csp {
+
+/// Rewrite rule for nodes of type \p T. Returned by `rewrite_rule()`
+template <typename T, typename F>
+struct rewrite_rule_t {
+    using node_type = T;
+    F function;
+};
+
+/// Creates a rewrite rule for nodes of type \p T. \p function is invoked with
+/// `T&` and returns a new owning pointer to replace the node with, or a null
+/// pointer to leave the node unchanged. The replacement may reuse children of
+/// the node by moving them out of it. Children that are moved out of the node
+/// must be part of the replacement.
+template <impl::Dynamic T, typename F>
+rewrite_rule_t<T, std::decay_t<F>> rewrite_rule(F&& function) {
+    return { (F&&)function };
+}
+
+/// Counters collected by `rewriter::run()`
+struct rewrite_stats {
+    /// Number of times nodes were taken from the worklist
+    size_t visited = 0;
+
+    /// Total number of rewrites
+    size_t rewrites = 0;
+
+    /// Number of rewrites per rule, in the order of the rules
+    std::vector<size_t> firings;
+
+    /// `false` if the rewrite limit was reached before a fixpoint
+    bool converged = true;
+};
+
+namespace impl {
+
+/// Maps type IDs to the bitset of rules for \p T... that apply to objects of
+/// that type. This is the same subtype relation that `visit` uses to select
+/// the overloads of a visitor
+template <typename Base, typename... T>
+inline constexpr Array RewriteRuleMasks =
+    []<size_t... ID>(std::index_sequence<ID...>) {
+    auto maskFor = [](size_t id) {
+        std::uint64_t mask = 0, bit = 1;
+        ((mask |= (IsaDispatchArray<T>[id] ? bit : 0), bit <<= 1), ...);
+        return mask;
+    };
+    return Array{ maskFor(ID)... };
+}(std::make_index_sequence<TypeToBound<Base>>{});
+
+} // namespace impl
+
+/// Applies rewrite rules to a tree until a fixpoint is reached. Rules are
+/// tried in the order they are passed to the constructor, the first rule that
+/// returns a replacement wins.
+template <typename... Rules>
+class rewriter {
+    static_assert(sizeof...(Rules) > 0 && sizeof...(Rules) <= 64,
+                  "Rewriters support 1 to 64 rules");
+
+public:
+    explicit rewriter(Rules... rules): _rules(std::move(rules)...) {}
+
+    /// Rewrites the tree owned by \p root. \p children is invoked with a node
+    /// and must return a range of references to the owning pointers of its
+    /// children.
+    ///
+    /// Nodes are first visited bottom-up. Afterwards only nodes created by
+    /// rewrites and the parents of rewritten nodes are visited again. At most
+    /// \p limit rewrites are performed.
+    template <typename Ptr, typename Children>
+    rewrite_stats run(Ptr& root, Children&& children,
+                      size_t limit = std::numeric_limits<size_t>::max()) {
+        using Base = impl::PointeeType<Ptr>;
+        constexpr auto const& Masks =
+            impl::RewriteRuleMasks<std::remove_cv_t<Base>,
+                                   typename Rules::node_type...>;
+        Run<Ptr, std::remove_reference_t<Children>> run(*this, children);
+        if (root) {
+            run.registerSubtree(root, nullptr);
+        }
+        while (!run.worklist.empty()) {
+            Base* node = run.worklist.front();
+            run.worklist.pop_front();
+            auto itr = run.entries.find(node);
+            if (itr == run.entries.end() || !itr->second.queued) {
+                /// The node was destroyed by a rewrite of one of its
+                /// ancestors, or it was already visited through an earlier
+                /// worklist entry with the same address
+                continue;
+            }
+            itr->second.queued = false;
+            ++run.stats.visited;
+            if (!Masks[(size_t)get_rtti(*node)]) {
+                continue;
+            }
+            if (run.stats.rewrites == limit) {
+                run.stats.converged = false;
+                break;
+            }
+            auto [slot, parent, queued] = itr->second;
+            auto replacement = run.apply(*node);
+            if (!replacement) {
+                continue;
+            }
+            /// Children that were moved into the replacement are no longer
+            /// reachable from `node`, so this only drops the nodes that are
+            /// destroyed together with it
+            run.unregisterSubtree(*node);
+            *slot = std::move(replacement);
+            if (*slot) {
+                run.registerSubtree(*slot, parent);
+            }
+            if (parent) {
+                run.enqueue(parent);
+            }
+        }
+        return std::move(run.stats);
+    }
+
+private:
+    template <typename Ptr, typename Children>
+    struct Run {
+        using Base = impl::PointeeType<Ptr>;
+
+        struct Entry {
+            Ptr* slot;
+            Base* parent;
+            bool queued;
+        };
+
+        Run(rewriter& self, Children& children):
+            self(self), children(children) {
+            stats.firings.resize(sizeof...(Rules));
+        }
+
+        rewriter& self;
+        Children& children;
+        std::unordered_map<Base*, Entry> entries;
+        std::deque<Base*> worklist;
+        rewrite_stats stats;
+
+        /// Appends \p node to the worklist unless it is already in it
+        void enqueue(Base* node) {
+            auto& entry = entries.find(node)->second;
+            if (!entry.queued) {
+                entry.queued = true;
+                worklist.push_back(node);
+            }
+        }
+
+        /// Registers the nodes of the subtree in \p slot that are not yet
+        /// registered and appends them to the worklist in post-order. Already
+        /// registered nodes were moved into the subtree by a rewrite. Their
+        /// entries are updated, but they and their descendants are not
+        /// visited again
+        void registerSubtree(Ptr& slot, Base* parent) {
+            struct Frame {
+                Ptr* slot;
+                Base* parent;
+                bool exit;
+            };
+            std::vector<Frame> stack = { { &slot, parent, false } };
+            while (!stack.empty()) {
+                auto frame = stack.back();
+                stack.pop_back();
+                Base* node = std::to_address(*frame.slot);
+                if (frame.exit) {
+                    entries[node] = { frame.slot, frame.parent, false };
+                    enqueue(node);
+                    continue;
+                }
+                if (auto itr = entries.find(node); itr != entries.end()) {
+                    itr->second.slot = frame.slot;
+                    itr->second.parent = frame.parent;
+                    continue;
+                }
+                stack.push_back({ frame.slot, frame.parent, true });
+                size_t const first = stack.size();
+                for (Ptr& child : std::invoke(children, *node)) {
+                    if (child) {
+                        stack.push_back({ &child, node, false });
+                    }
+                }
+                std::reverse(stack.begin() + first, stack.end());
+            }
+        }
+
+        /// Removes all nodes of the subtree rooted at \p root from the index
+        void unregisterSubtree(Base& root) {
+            std::vector<Base*> stack = { &root };
+            while (!stack.empty()) {
+                Base* node = stack.back();
+                stack.pop_back();
+                entries.erase(node);
+                for (Ptr& child : std::invoke(children, *node)) {
+                    if (child) {
+                        stack.push_back(std::to_address(child));
+                    }
+                }
+            }
+        }
+
+        /// Applies the first rule that rewrites \p node
+        /// \Returns the replacement or a null pointer
+        Ptr apply(Base& node) {
+            return csp::visit(node, [&]<typename Derived>(Derived& derived) {
+                Ptr result = nullptr;
+                [&]<size_t... I>(std::index_sequence<I...>) {
+                    (tryRule<I>(derived, result) || ...);
+                }(std::index_sequence_for<Rules...>{});
+                return result;
+            });
+        }
+
+        template <size_t I, typename Derived>
+        bool tryRule(Derived& node, Ptr& result) {
+            auto& rule = std::get<I>(self._rules);
+            using T = typename std::remove_reference_t<
+                decltype(rule)>::node_type;
+            if constexpr (!std::is_base_of_v<T, Derived>) {
+                return false;
+            }
+            else {
+                result = std::invoke(rule.function, static_cast<T&>(node));
+                if (!result) {
+                    return false;
+                }
+                ++stats.rewrites;
+                ++stats.firings[I];
+                return true;
+            }
+        }
+    };
+
+    std::tuple<Rules...> _rules;
+};
+
+} // namespace csp
+
+#endif // CSP_REWRITE_HPP
@@ -0,0 +1,337 @@
+#ifndef CSP_TRAVERSE_HPP
+#define CSP_TRAVERSE_HPP
+
+#include <algorithm> // For std::reverse
+#include <concepts>
+#include <functional>
+#include <ranges>
+#include <vector>
+
+#include "../csp.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CSP_IMPL_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define CSP_IMPL_PREFETCH(addr) ((void)(addr))
+#endif
+
+/// # Tree traversal
+///
+/// `traverse` walks a tree of dynamic objects in pre- and post-order without
+/// recursion. The nodes that remain to be visited are kept on an explicit
+/// stack, so arbitrarily deep trees can be traversed without growing the call
+/// stack. Every node is dispatched to the visitors through `visit`.
+
+namespace csp {
+
+/// Returned by traversal visitors to control the traversal. Visitors that
+/// return anything else always proceed.
+enum class traverse_control {
+    /// Continue with the children of the node
+    proceed,
+
+    /// Do not traverse the children of the node. The post-order visitor is
+    /// still invoked for the node itself
+    skip_children,
+
+    /// Terminate the traversal immediately
+    stop
+};
+
+namespace impl {
+
+/// Object type of the nodes of a tree with root type \p Root and children
+/// function \p Children. This is the type the children of a node refer to,
+/// const qualified if \p Root is const.
+template <typename Root, typename Children>
+using TraversalNodeType = std::conditional_t<
+    std::is_const_v<Root>,
+    std::remove_reference_t<decltype(derefElement(
+        std::declval<std::ranges::range_reference_t<
+            std::invoke_result_t<Children&, Root&>>>()))> const,
+    std::remove_reference_t<decltype(derefElement(
+        std::declval<std::ranges::range_reference_t<
+            std::invoke_result_t<Children&, Root&>>>()))>>;
+
+/// Function object that ignores its arguments. Used as the default post-order
+/// visitor.
+struct NoOpVisitor {
+    void operator()(auto&...) const {}
+};
+
+/// `std::true_type` if \p F is a specialization of `fuse`
+template <typename F>
+struct IsFuse: std::false_type {};
+
+template <typename... F>
+struct IsFuse<fuse<F...>>: std::true_type {};
+
+/// Converts the result of a traversal visitor to a `traverse_control`
+template <typename Result>
+traverse_control toTraverseControl(Result const& result) {
+    if constexpr (std::is_same_v<Result, traverse_control>) {
+        return result;
+    }
+    else {
+        return traverse_control::proceed;
+    }
+}
+
+/// Combines the results of the components of a fused visitor. The traversal
+/// stops if any component stops it and skips the children if all components
+/// skip them
+template <typename... R>
+traverse_control combineTraverseControls(std::tuple<R...> const& results) {
+    return std::apply(
+        [](auto const&... result) {
+        traverse_control controls[] = { toTraverseControl(result)... };
+        if (std::ranges::find(controls, traverse_control::stop) !=
+            std::end(controls))
+        {
+            return traverse_control::stop;
+        }
+        if (std::ranges::all_of(controls, [](traverse_control control) {
+            return control == traverse_control::skip_children;
+        })) {
+            return traverse_control::skip_children;
+        }
+        return traverse_control::proceed;
+    },
+        results);
+}
+
+/// Dispatches \p node to \p f and converts the result to a
+/// `traverse_control`
+template <typename Node, typename F>
+traverse_control visitTraversal(Node& node, F& f) {
+    return csp::visit(node, [&]<typename Derived>(Derived& derived)
+                                -> traverse_control
+                      requires std::invocable<F&, Derived&>
+    {
+        using Result = std::invoke_result_t<F&, Derived&>;
+        if constexpr (std::is_same_v<Result, traverse_control>) {
+            return std::invoke(f, derived);
+        }
+        else if constexpr (IsFuse<std::remove_cv_t<F>>::value) {
+            return combineTraverseControls(std::invoke(f, derived));
+        }
+        else {
+            std::invoke(f, derived);
+            return traverse_control::proceed;
+        }
+    });
+}
+
+} // namespace impl
+
+/// Traverses the tree rooted at \p root in depth-first order. \p children is
+/// invoked with a node and must return a range of its children as pointers,
+/// smart pointers or references. Null pointers are skipped. Every node is
+/// dispatched through `visit` to \p pre before its children are traversed and
+/// to \p post after all of its children have been traversed. Children are
+/// traversed in the order of the range.
+///
+/// Visitors may return a `traverse_control` to skip the children of a node or
+/// to stop the traversal. Other return values are ignored. For `fuse`d
+/// visitors the traversal stops if any component returns `stop` and skips the
+/// children if all components return `skip_children`.
+///
+/// The traversal is iterative: Pending nodes are kept on a heap allocated
+/// stack, and the children of a node are prefetched when they are pushed.
+///
+/// \Returns `false` if the traversal was stopped by a visitor, `true`
+/// otherwise
+template <impl::Dynamic Root, typename Children, typename Pre,
+          typename Post = impl::NoOpVisitor>
+bool traverse(Root& root, Children&& children, Pre&& pre, Post&& post = {}) {
+    using Node = impl::TraversalNodeType<Root, Children>;
+    constexpr bool HasPost =
+        !std::is_same_v<std::remove_cvref_t<Post>, impl::NoOpVisitor>;
+    struct Frame {
+        Node* node;
+        bool exit;
+    };
+    std::vector<Frame> stack;
+    stack.push_back({ &root, false });
+    while (!stack.empty()) {
+        auto [node, exit] = stack.back();
+        stack.pop_back();
+        if (exit) {
+            if (impl::visitTraversal(*node, post) == traverse_control::stop) {
+                return false;
+            }
+            continue;
+        }
+        auto control = impl::visitTraversal(*node, pre);
+        if (control == traverse_control::stop) {
+            return false;
+        }
+        if constexpr (HasPost) {
+            stack.push_back({ node, true });
+        }
+        if (control == traverse_control::skip_children) {
+            continue;
+        }
+        /// Push the children and reverse them in place so the first child is
+        /// on top of the stack
+        size_t const first = stack.size();
+        for (auto&& elem : std::invoke(children, *node)) {
+            if (impl::isNullElement(elem)) {
+                continue;
+            }
+            Node* child = &static_cast<Node&>(impl::derefElement(elem));
+            CSP_IMPL_PREFETCH(child);
+            stack.push_back({ child, false });
+        }
+        std::reverse(stack.begin() + first, stack.end());
+    }
+    return true;
+}
+
+/// Declares whether the subtrees below nodes of type \p Node can contain
+/// objects of type \p T. Specialize this to `false` to let `descendants` prune
+/// subtrees that cannot contain the searched type, e.g.
+///
+///     template <typename T>
+///     inline constexpr bool csp::may_contain<Literal, T> = false;
+///
+/// A declaration for a base class of \p Node applies to all derived classes,
+/// and a declaration for a base class of \p T applies to all classes derived
+/// from it.
+template <typename Node, typename T>
+inline constexpr bool may_contain = true;
+
+namespace impl {
+
+/// `may_contain<A, B>` for all ancestors `A` of \p Node and all ancestors `B`
+/// of \p T, including themselves
+template <typename Node, typename T>
+constexpr bool ctMayContain() {
+    bool result = may_contain<Node, T>;
+    if constexpr (!std::is_void_v<TypeToParent<T>>) {
+        result = result && ctMayContain<Node, TypeToParent<T>>();
+    }
+    if constexpr (!std::is_void_v<TypeToParent<Node>>) {
+        result = result && ctMayContain<TypeToParent<Node>, T>();
+    }
+    return result;
+}
+
+/// Maps the type ID of a node to `true` if its subtree may contain objects of
+/// type \p T
+template <typename T>
+inline constexpr Array MayContainArray =
+    []<size_t... I>(std::index_sequence<I...>) {
+    using IDType = TypeToIDType<T>;
+    return Array{ ctMayContain<IDToType<IDType(I)>, T>()... };
+}(std::make_index_sequence<TypeToBound<T>>{});
+
+} // namespace impl
+
+/// Lazy range of the descendants of a node that are of type \p T. Returned by
+/// `descendants()`
+template <typename T, typename Node, typename Children>
+class descendants_view: public std::ranges::view_interface<
+                            descendants_view<T, Node, Children>> {
+public:
+    using value_type = std::remove_cv_t<T>;
+    using reference = impl::copy_cvref_t<Node&, value_type>;
+
+    class iterator {
+    public:
+        using iterator_concept = std::input_iterator_tag;
+        using value_type = descendants_view::value_type;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        reference operator*() const { return static_cast<reference>(*_node); }
+
+        iterator& operator++() {
+            advance();
+            return *this;
+        }
+
+        void operator++(int) { advance(); }
+
+        bool operator==(std::default_sentinel_t) const {
+            return _node == nullptr;
+        }
+
+    private:
+        friend class descendants_view;
+
+        explicit iterator(descendants_view* view): _view(view) {
+            expand(*view->_root);
+            advance();
+        }
+
+        /// Pushes the children of \p node unless its subtree cannot contain
+        /// objects of type `T`
+        void expand(Node& node) {
+            if (!impl::MayContainArray<value_type>[(size_t)get_rtti(node)]) {
+                return;
+            }
+            size_t const first = _stack.size();
+            for (auto&& elem : std::invoke(_view->_children, node)) {
+                if (!impl::isNullElement(elem)) {
+                    _stack.push_back(
+                        &static_cast<Node&>(impl::derefElement(elem)));
+                }
+            }
+            std::reverse(_stack.begin() + first, _stack.end());
+        }
+
+        /// Advances to the next node in pre-order that is of type `T`
+        void advance() {
+            while (!_stack.empty()) {
+                Node* node = _stack.back();
+                _stack.pop_back();
+                expand(*node);
+                if (isa<value_type>(*node)) {
+                    _node = node;
+                    return;
+                }
+            }
+            _node = nullptr;
+        }
+
+        descendants_view* _view = nullptr;
+        Node* _node = nullptr;
+        std::vector<Node*> _stack;
+    };
+
+    descendants_view(Node& root, Children children):
+        _root(&root), _children(std::move(children)) {}
+
+    /// Starts a new traversal. Every iterator owns its own traversal state
+    iterator begin() { return iterator(this); }
+
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    Node* _root;
+    Children _children;
+};
+
+/// \Returns a lazy range of the descendants of \p root that are of type \p T,
+/// in pre-order. \p root itself is not included. \p children is invoked with
+/// a node and must return a range of its children as pointers, smart pointers
+/// or references.
+///
+/// The tree is traversed on demand, so stopping the iteration early skips the
+/// rest of the tree. Subtrees of nodes that cannot contain objects of type
+/// \p T according to `may_contain` are not traversed.
+template <impl::Dynamic T, impl::Dynamic Root, typename Children>
+requires impl::SharesTypeHierarchyWith<Root, T>
+auto descendants(Root& root, Children&& children) {
+    using Node = impl::TraversalNodeType<Root, Children>;
+    return descendants_view<T, Node, std::decay_t<Children>>(
+        root, (Children&&)children);
+}
+
+} // namespace csp
+
+#undef CSP_IMPL_PREFETCH
+
+#endif // CSP_TRAVERSE_HPP
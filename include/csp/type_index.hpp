@@ -0,0 +1,180 @@
+#ifndef CSP_TYPE_INDEX_HPP
+#define CSP_TYPE_INDEX_HPP
+
+#include <array>
+#include <cassert>
+#include <iterator>
+#include <ranges>
+#include <unordered_map>
+#include <vector>
+
+#include "column.hpp"
+
+/// # Type index
+///
+/// `type_index` maintains one list of registered objects per concrete type, so
+/// queries for all objects of a type visit only the matching objects instead of
+/// scanning all of them with `isa`.
+
+namespace csp {
+
+/// Registry of objects of the hierarchy of \p Base grouped by their runtime
+/// type. Objects are not owned by the index. They must be erased before they
+/// are destroyed.
+template <impl::Dynamic Base>
+class type_index {
+    static constexpr size_t NumTypes = impl::TypeToBound<Base>;
+
+public:
+    /// Range of the registered objects of type \p T. Objects are grouped by
+    /// concrete type in the order of the type IDs. The view is invalidated by
+    /// `insert`, `erase` and `clear`.
+    template <typename T>
+    class view: public std::ranges::view_interface<view<T>> {
+        using Test = impl::ColumnIsaTest<T>;
+
+    public:
+        class iterator {
+        public:
+            using iterator_concept = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+
+            iterator() = default;
+
+            T& operator*() const {
+                return static_cast<T&>(*bucket()[_pos]);
+            }
+
+            iterator& operator++() {
+                ++_pos;
+                skipEmpty();
+                return *this;
+            }
+
+            iterator operator++(int) {
+                auto result = *this;
+                ++*this;
+                return result;
+            }
+
+            bool operator==(iterator const& rhs) const {
+                return _match == rhs._match && _pos == rhs._pos;
+            }
+
+        private:
+            friend class view;
+
+            iterator(type_index const* index, size_t match):
+                _index(index), _match(match) {
+                skipEmpty();
+            }
+
+            std::vector<Base*> const& bucket() const {
+                return _index->_buckets[Test::Matches[_match]];
+            }
+
+            /// Moves to the first element of the next nonempty bucket if the
+            /// current bucket is exhausted
+            void skipEmpty() {
+                while (_match < Test::NumMatches && _pos == bucket().size()) {
+                    ++_match;
+                    _pos = 0;
+                }
+            }
+
+            type_index const* _index = nullptr;
+            size_t _match = 0;
+            size_t _pos = 0;
+        };
+
+        iterator begin() const { return iterator(_index, 0); }
+
+        iterator end() const { return iterator(_index, Test::NumMatches); }
+
+        /// \Returns the number of registered objects of type `T`
+        size_t size() const { return _index->template count<T>(); }
+
+    private:
+        friend class type_index;
+
+        explicit view(type_index const* index): _index(index) {}
+
+        type_index const* _index;
+    };
+
+    /// Registers \p object. \p object must not already be registered.
+    void insert(Base& object) {
+        auto& bucket = _buckets[(size_t)get_rtti(object)];
+        [[maybe_unused]] bool inserted =
+            _positions.insert({ &object, bucket.size() }).second;
+        assert(inserted && "Object is already registered");
+        bucket.push_back(&object);
+    }
+
+    /// Removes \p object from the index. The last object of the same type
+    /// takes its position.
+    /// \Returns `true` if \p object was registered
+    bool erase(Base const& object) {
+        auto itr = _positions.find(&object);
+        if (itr == _positions.end()) {
+            return false;
+        }
+        auto& bucket = _buckets[(size_t)get_rtti(object)];
+        size_t const pos = itr->second;
+        _positions.erase(itr);
+        if (pos != bucket.size() - 1) {
+            bucket[pos] = bucket.back();
+            _positions[bucket[pos]] = pos;
+        }
+        bucket.pop_back();
+        return true;
+    }
+
+    /// \Returns `true` if \p object is registered
+    bool contains(Base const& object) const {
+        return _positions.contains(&object);
+    }
+
+    /// Removes all objects
+    void clear() {
+        for (auto& bucket : _buckets) {
+            bucket.clear();
+        }
+        _positions.clear();
+    }
+
+    /// \Returns the total number of registered objects
+    size_t size() const { return _positions.size(); }
+
+    /// \Returns `true` if no objects are registered
+    bool empty() const { return _positions.empty(); }
+
+    /// \Returns a range of all registered objects of type \p T, i.e. the
+    /// concatenation of the lists of all concrete types derived from \p T
+    template <impl::Dynamic T>
+    requires impl::SharesTypeHierarchyWith<Base, T>
+    view<T> of() const {
+        return view<T>(this);
+    }
+
+    /// \Returns the number of registered objects of type \p T
+    template <impl::Dynamic T>
+    requires impl::SharesTypeHierarchyWith<Base, T>
+    size_t count() const {
+        using Test = impl::ColumnIsaTest<T>;
+        size_t result = 0;
+        for (size_t i = 0; i < Test::NumMatches; ++i) {
+            result += _buckets[Test::Matches[i]].size();
+        }
+        return result;
+    }
+
+private:
+    std::array<std::vector<Base*>, NumTypes> _buckets;
+    std::unordered_map<Base const*, size_t> _positions;
+};
+
+} // namespace csp
+
+#endif // CSP_TYPE_INDEX_HPP
@@ -1,9 +1,25 @@
 #define CSP_IMPL_ENABLE_DEBUGGING
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <functional>
+#include <span>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <csp.hpp>
+#include <csp/batch.hpp>
+#include <csp/clone.hpp>
+#include <csp/column.hpp>
+#include <csp/intern.hpp>
+#include <csp/match.hpp>
+#include <csp/memo.hpp>
+#include <csp/parallel.hpp>
+#include <csp/rewrite.hpp>
+#include <csp/traverse.hpp>
+#include <csp/type_index.hpp>
 
 /// # Enum reflection tests
 
@@ -876,6 +892,9 @@ static void testDynUnion() {
     assert(get_rtti(a2.base()) == ID::Leopard);
     auto a3 = std::move(a2);
     assert(get_rtti(a3.base()) == ID::Leopard);
+    /// Rvalue access refers to the member instead of a copy
+    Animal&& moved = std::move(a3).base();
+    assert(&moved == &a3.base());
 }
 
 static void testPartialUnion() {
@@ -919,6 +938,9 @@ struct B;
 
 csp::unique_ptr<A> makeA(int*);
 void do_delete(A&);
+void do_destroy(A&);
+
+int numDestroyed = 0;
 
 } // namespace ext_del
 
@@ -957,6 +979,11 @@ void ext_del::do_delete(A& a) {
     csp::visit(a, [](auto& a) { delete &a; });
 }
 
+void ext_del::do_destroy(A& a) {
+    ++numDestroyed;
+    csp::visit(a, [](auto& a) { std::destroy_at(&a); });
+}
+
 static void testUniquePtr() {
     {
         auto p = ext_del::makeA(nullptr);
@@ -973,6 +1000,940 @@ static void testUniquePtr() {
     }
 }
 
+namespace {
+
+/// `Car` and `SportsCar` are not adjacent, so `isa<Car>` matches a set of IDs
+/// that is not contiguous
+enum class VehicleID { Vehicle, Car, Boat, SportsCar };
+
+struct Vehicle;
+struct Car;
+struct Boat;
+struct SportsCar;
+
+} // namespace
+
+CSP_DEFINE(Vehicle, VehicleID::Vehicle, void, Abstract)
+CSP_DEFINE(Car, VehicleID::Car, Vehicle, Concrete)
+CSP_DEFINE(Boat, VehicleID::Boat, Vehicle, Concrete)
+CSP_DEFINE(SportsCar, VehicleID::SportsCar, Car, Concrete)
+
+namespace {
+
+struct Vehicle: csp::base_helper<Vehicle> {
+    using base_helper::base_helper;
+};
+
+struct Car: Vehicle {
+    Car(VehicleID ID = VehicleID::Car): Vehicle(ID) {}
+};
+
+struct Boat: Vehicle {
+    Boat(): Vehicle(VehicleID::Boat) {}
+};
+
+struct SportsCar: Car {
+    SportsCar(): Car(VehicleID::SportsCar) {}
+};
+
+} // namespace
+
+/// Checks the column kernels for \p Test against `isa` on every element
+template <typename Test, typename Column, typename T>
+static void checkColumnIsa(Column const& column, std::vector<T*> const& objs) {
+    assert(column.size() == objs.size());
+    auto mask = csp::isa_mask<Test>(column);
+    size_t count = 0;
+    for (size_t i = 0; i < objs.size(); ++i) {
+        bool isTest = csp::isa<Test>(objs[i]);
+        count += isTest;
+        assert(bool(mask[i / 64] >> (i % 64) & 1) == isTest);
+    }
+    assert(csp::count_isa<Test>(column) == count);
+}
+
+static void testRTTIColumn() {
+    Dolphin dolphin;
+    Whale whale;
+    Leopard leopard;
+    std::vector<Animal*> animals;
+    for (size_t i = 0; i < 203; ++i) {
+        switch (i * 7 % 5) {
+        case 0: animals.push_back(&dolphin); break;
+        case 1: animals.push_back(&leopard); break;
+        default: animals.push_back(&whale); break;
+        }
+    }
+    csp::rtti_column column(animals);
+    static_assert(std::is_same_v<decltype(column), csp::rtti_column<Animal>>);
+    assert(column.size() == animals.size());
+    auto mask = csp::isa_mask<Cetacea>(column);
+    assert(mask.size() == 4);
+    size_t numCetacea = 0;
+    for (size_t i = 0; i < animals.size(); ++i) {
+        bool isCetacea = csp::isa<Cetacea>(animals[i]);
+        numCetacea += isCetacea;
+        assert(bool(mask[i / 64] >> (i % 64) & 1) == isCetacea);
+    }
+    assert(csp::count_isa<Cetacea>(column) == numCetacea);
+    assert(csp::count_isa<Animal>(column) == animals.size());
+    auto histogram = csp::type_histogram(column);
+    assert(histogram[(size_t)ID::Animal] == 0);
+    assert(histogram[(size_t)ID::Whale] + histogram[(size_t)ID::Dolphin] ==
+           numCetacea);
+    assert(histogram[(size_t)ID::Leopard] == animals.size() - numCetacea);
+    auto partition = csp::partition_by_type(column);
+    auto leopards = partition.of(ID::Leopard);
+    assert(leopards.size() == histogram[(size_t)ID::Leopard]);
+    for (size_t i = 0; i < leopards.size(); ++i) {
+        assert(animals[leopards[i]] == &leopard);
+        assert(i == 0 || leopards[i - 1] < leopards[i]);
+    }
+    column.set(0, ID::Leopard);
+    column.erase(1);
+    column.push_back(&dolphin);
+    assert(column[0] == ID::Leopard);
+    assert(column.size() == animals.size());
+    assert(column[column.size() - 1] == ID::Dolphin);
+    /// IDs stored as 16 bit values
+    csp::rtti_column<Animal, std::uint16_t> wideColumn(animals);
+    static_assert(sizeof(*wideColumn.data()) == 2);
+    checkColumnIsa<Cetacea>(wideColumn, animals);
+    checkColumnIsa<Leopard>(wideColumn, animals);
+    assert(csp::type_histogram(wideColumn) == histogram);
+    /// Matching IDs that are not contiguous
+    static_assert(!csp::impl::ColumnIsaTest<Car>::Contiguous);
+    Car car;
+    Boat boat;
+    SportsCar sportsCar;
+    std::vector<Vehicle*> vehicles;
+    for (size_t i = 0; i < 203; ++i) {
+        switch (i * 5 % 7) {
+        case 0: vehicles.push_back(&boat); break;
+        case 1:
+        case 2: vehicles.push_back(&sportsCar); break;
+        default: vehicles.push_back(&car); break;
+        }
+    }
+    checkColumnIsa<Car>(csp::rtti_column(vehicles), vehicles);
+    checkColumnIsa<Car>(csp::rtti_column<Vehicle, std::uint16_t>(vehicles),
+                        vehicles);
+    checkColumnIsa<Boat>(csp::rtti_column<Vehicle, std::uint16_t>(vehicles),
+                         vehicles);
+}
+
+static void testVisitBatch() {
+    Dolphin d0, d1;
+    Whale w0, w1;
+    Leopard l0;
+    std::vector<Animal*> animals = { &d0, &l0, &w0, &d1, &w1 };
+    std::vector<Animal const*> visited;
+    // clang-format off
+    csp::visit_batch(animals, csp::overload{
+        [&](Cetacea const& c) { visited.push_back(&c); },
+        [&](Leopard const& l) { visited.push_back(&l); },
+    }); // clang-format on
+    std::vector<Animal const*> expected = { &w0, &w1, &d0, &d1, &l0 };
+    assert(visited == expected);
+    /// The ordered variant also invokes the visitor in the order of the input
+    visited.clear();
+    auto record = [&](Animal const& animal, int result) {
+        visited.push_back(&animal);
+        return result;
+    };
+    // clang-format off
+    auto results = csp::visit_batch_ordered(animals, csp::overload{
+        [&](Whale const& w) { return record(w, 1); },
+        [&](Dolphin const& d) { return record(d, 2); },
+        [&](Leopard const& l) { return record(l, 3); },
+    }); // clang-format on
+    assert((results == std::vector{ 2, 3, 1, 2, 1 }));
+    assert(visited == std::vector<Animal const*>(animals.begin(),
+                                                 animals.end()));
+}
+
+static void testForEachHomogeneous() {
+    /// Pointers
+    {
+        Dolphin d0, d1;
+        Whale w0;
+        Leopard l0;
+        std::vector<Animal*> animals = { &d0, &d1, &w0, &l0, &d0 };
+        std::vector<Animal const*> visited;
+        csp::for_each_homogeneous(animals, [&](Animal const& animal) {
+            visited.push_back(&animal);
+        });
+        assert(visited == std::vector<Animal const*>(animals.begin(),
+                                                     animals.end()));
+    }
+    /// Unique pointers
+    {
+        std::vector<csp::unique_ptr<Animal>> animals;
+        animals.push_back(csp::make_unique<Whale>());
+        animals.push_back(csp::make_unique<Whale>());
+        animals.push_back(csp::make_unique<Leopard>());
+        std::vector<ID> IDs;
+        csp::for_each_homogeneous(animals, [&]<typename T>(T&) {
+            static_assert(!std::is_same_v<T, Animal>);
+            IDs.push_back(csp::impl::TypeToID<T>);
+        });
+        assert((IDs == std::vector{ ID::Whale, ID::Whale, ID::Leopard }));
+    }
+    /// Unions
+    {
+        std::vector<csp::dyn_union<Animal>> animals;
+        animals.push_back(Dolphin());
+        animals.push_back(Leopard());
+        animals.push_back(Leopard());
+        int numLeopards = 0;
+        // clang-format off
+        csp::for_each_homogeneous(animals, csp::overload{
+            [&](Cetacea&) {},
+            [&](Leopard&) { ++numLeopards; },
+        }); // clang-format on
+        assert(numLeopards == 2);
+    }
+    /// Every element is dereferenced once
+    {
+        Dolphin d0;
+        Whale w0;
+        std::vector<Animal*> animals = { &d0, &d0, &w0, &d0 };
+        size_t numDerefs = 0;
+        auto counted = animals | std::views::transform([&](Animal* animal) {
+            ++numDerefs;
+            return animal;
+        });
+        size_t numVisited = 0;
+        csp::for_each_homogeneous(counted, [&](Animal&) { ++numVisited; });
+        assert(numVisited == animals.size());
+        assert(numDerefs == animals.size());
+    }
+}
+
+static void testParallelVisit() {
+    Dolphin dolphin;
+    Whale whale;
+    Leopard leopard;
+    std::vector<Animal*> animals;
+    for (size_t i = 0; i < 10000; ++i) {
+        Animal* options[] = { &dolphin, &whale, &leopard };
+        animals.push_back(options[i * 7 % 3]);
+    }
+    csp::work_stealing_pool pool(4);
+    csp::parallel_options options{ .pool = &pool, .grain_size = 100 };
+    std::atomic<size_t> numCetacea = 0;
+    // clang-format off
+    csp::parallel_visit(animals, csp::overload{
+        [&](Cetacea const&) { ++numCetacea; },
+        [&](Leopard const&) {},
+    }, options); // clang-format on
+    assert(numCetacea == 2 * animals.size() / 3 + 1);
+    // clang-format off
+    auto sum = csp::parallel_visit_reduce(animals, csp::overload{
+        [](Whale const&) { return size_t(1); },
+        [](Dolphin const&) { return size_t(2); },
+        [](Leopard const&) { return size_t(3); },
+    }, std::plus<>{}, options); // clang-format on
+    assert(sum == 2 * animals.size());
+    auto empty = csp::parallel_visit_reduce(std::vector<Animal*>{},
+                                            [](auto&) { return 1; },
+                                            std::plus<>{}, options);
+    assert(empty == 0);
+    CHECK_THROWS(csp::parallel_visit(animals, [](auto&) { throw 0; },
+                                     options));
+    /// `spawn_n` runs every index exactly once, also when the waiting thread
+    /// has to sleep until tasks on other threads complete
+    std::vector<std::atomic<int>> counts(1000);
+    csp::task_group group;
+    auto countIndex = [&](size_t i) {
+        if (i % 250 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        ++counts[i];
+    };
+    pool.spawn_n(group, counts.size(), countIndex);
+    pool.wait(group);
+    assert(std::ranges::all_of(counts, [](auto& c) { return c == 1; }));
+}
+
+static void testParallelTraverse() {
+    /// Build a complete binary tree where node `i` has the children `2i + 1`
+    /// and `2i + 2`
+    size_t const numNodes = 2000;
+    std::vector<csp::unique_ptr<Animal>> nodes;
+    std::unordered_map<Animal const*, size_t> indices;
+    for (size_t i = 0; i < numNodes; ++i) {
+        switch (i % 3) {
+        case 0:
+            nodes.push_back(csp::make_unique<Dolphin>());
+            break;
+        case 1:
+            nodes.push_back(csp::make_unique<Whale>());
+            break;
+        default:
+            nodes.push_back(csp::make_unique<Leopard>());
+            break;
+        }
+        indices[nodes.back().get()] = i;
+    }
+    std::vector<std::vector<Animal*>> childTable(numNodes);
+    for (size_t i = 0; i < numNodes; ++i) {
+        for (size_t j : { 2 * i + 1, 2 * i + 2 }) {
+            childTable[i].push_back(j < numNodes ? nodes[j].get() : nullptr);
+        }
+    }
+    auto children = [&](Animal const& node) -> auto& {
+        return childTable[indices.at(&node)];
+    };
+    csp::work_stealing_pool pool(4);
+    csp::parallel_options options{ .pool = &pool, .spawn_depth = 4 };
+    std::atomic<size_t> clock = 0;
+    std::vector<size_t> preStamps(numNodes), postStamps(numNodes);
+    csp::per_thread<size_t> numLeopards(pool);
+    csp::parallel_traverse(
+        *nodes[0], children,
+        [&](Animal const& node) {
+        preStamps[indices.at(&node)] = ++clock;
+        if (csp::isa<Leopard>(node)) {
+            ++numLeopards.local();
+        }
+    }, [&](Animal const& node) { postStamps[indices.at(&node)] = ++clock; },
+        options);
+    assert(clock == 2 * numNodes);
+    for (size_t i = 1; i < numNodes; ++i) {
+        size_t parent = (i - 1) / 2;
+        assert(preStamps[parent] < preStamps[i]);
+        assert(postStamps[i] < postStamps[parent]);
+    }
+    assert(numLeopards.combine(std::plus<>{}) == numNodes / 3);
+    std::atomic<size_t> numVisited = 0;
+    // clang-format off
+    csp::parallel_traverse(std::as_const(*nodes[0]), children, csp::overload{
+        [&](Cetacea const&) { ++numVisited; },
+        [&](Leopard const&) {},
+    }, options); // clang-format on
+    assert(numVisited == numNodes - numNodes / 3);
+    CHECK_THROWS(csp::parallel_traverse(*nodes[0], children,
+                                        [](auto&) { throw 0; }, options));
+    /// Throwing below the root must not leave spawned siblings running
+    for (size_t depth : { size_t(1), size_t(3), size_t(6) }) {
+        auto throwAtDepth = [&](Animal const& node) {
+            size_t nodeDepth = 0;
+            for (size_t i = indices.at(&node); i > 0; i = (i - 1) / 2) {
+                ++nodeDepth;
+            }
+            if (nodeDepth == depth) {
+                throw 0;
+            }
+        };
+        CHECK_THROWS(
+            csp::parallel_traverse(*nodes[0], children, throwAtDepth, options));
+        CHECK_THROWS(csp::parallel_traverse(*nodes[0], children,
+                                            [](Animal const&) {}, throwAtDepth,
+                                            options));
+    }
+}
+
+static void testFuse() {
+    Whale whale;
+    Leopard leopard;
+    int numVisited = 0;
+    // clang-format off
+    auto fused = csp::fuse{
+        csp::overload{
+            [](Cetacea const&) { return 1; },
+            [](Leopard const&) { return 2; },
+        },
+        [](Animal const& animal) { return csp::isa<Whale>(animal); },
+        [&](Animal const&) { ++numVisited; },
+    }; // clang-format on
+    auto [a, b, c] = csp::visit(static_cast<Animal const&>(whale), fused);
+    assert(a == 1 && b && numVisited == 1);
+    static_assert(std::is_same_v<decltype(c), csp::fused_void>);
+    auto result = csp::visit(static_cast<Animal const&>(leopard), fused);
+    assert((result == std::tuple{ 2, false, csp::fused_void{} }));
+    assert(numVisited == 2);
+    /// Fused visitors with two dispatched arguments
+    auto pairFused = csp::fuse{
+        [](Animal const&, Animal const&) { return 0; },
+        [](auto const& a, auto const& b) {
+        return csp::isa<Whale>(a) && csp::isa<Leopard>(b);
+    },
+    };
+    auto [zero, isWhaleLeopard] =
+        csp::visit(static_cast<Animal const&>(whale),
+                   static_cast<Animal const&>(leopard), pairFused);
+    assert(zero == 0 && isWhaleLeopard);
+    /// Copies and const fused visitors
+    auto copy = fused;
+    auto const constFused = copy;
+    auto constResult =
+        csp::visit(static_cast<Animal const&>(whale), constFused);
+    assert((constResult == std::tuple{ 1, true, csp::fused_void{} }));
+    assert(numVisited == 3);
+    /// The result of a single visitor that returns a tuple is nested
+    auto single = csp::fuse{ [](Animal const&) { return std::tuple{ 1, 2 }; } };
+    auto singleResult = csp::visit(static_cast<Animal const&>(whale), single);
+    static_assert(std::is_same_v<decltype(singleResult),
+                                 std::tuple<std::tuple<int, int>>>);
+    assert(std::get<0>(singleResult) == std::tuple(1, 2));
+}
+
+static void testTraverse() {
+    /// Node `i` has the children `2i + 1` and `2i + 2`
+    Dolphin dolphins[7];
+    Whale whale;
+    Leopard leopard;
+    std::vector<Animal*> nodes;
+    for (auto& dolphin : dolphins) {
+        nodes.push_back(&dolphin);
+    }
+    nodes[1] = &whale;
+    nodes[5] = &leopard;
+    auto index = [&](Animal const& node) {
+        return size_t(std::find(nodes.begin(), nodes.end(), &node) -
+                      nodes.begin());
+    };
+    auto children = [&](Animal const& node) {
+        size_t i = index(node);
+        std::vector<Animal const*> result;
+        for (size_t j : { 2 * i + 1, 2 * i + 2 }) {
+            result.push_back(j < nodes.size() ? nodes[j] : nullptr);
+        }
+        return result;
+    };
+    std::vector<size_t> pre, post;
+    bool completed = csp::traverse(
+        std::as_const(*nodes[0]), children,
+        [&](Animal const& node) { pre.push_back(index(node)); },
+        [&](Animal const& node) { post.push_back(index(node)); });
+    assert(completed);
+    assert((pre == std::vector<size_t>{ 0, 1, 3, 4, 2, 5, 6 }));
+    assert((post == std::vector<size_t>{ 3, 4, 1, 5, 6, 2, 0 }));
+    pre.clear();
+    // clang-format off
+    completed = csp::traverse(std::as_const(*nodes[0]), children, csp::overload{
+        [&](Whale const& node) {
+            pre.push_back(index(node));
+            return csp::traverse_control::skip_children;
+        },
+        [&](Animal const& node) { pre.push_back(index(node)); },
+    }); // clang-format on
+    assert(completed);
+    assert((pre == std::vector<size_t>{ 0, 1, 2, 5, 6 }));
+    pre.clear();
+    // clang-format off
+    completed = csp::traverse(std::as_const(*nodes[0]), children, csp::overload{
+        [&](Leopard const& node) {
+            pre.push_back(index(node));
+            return csp::traverse_control::stop;
+        },
+        [&](Animal const& node) {
+            pre.push_back(index(node));
+            return csp::traverse_control::proceed;
+        },
+    }); // clang-format on
+    assert(!completed);
+    assert((pre == std::vector<size_t>{ 0, 1, 3, 4, 2, 5 }));
+    /// Fused visitors run several analyses in one traversal
+    size_t numWhales = 0, numNodes = 0;
+    // clang-format off
+    csp::traverse(std::as_const(*nodes[0]), children, csp::fuse{
+        [&](Animal const& node) { numWhales += csp::isa<Whale>(node); },
+        [&](Animal const&) { ++numNodes; },
+    }); // clang-format on
+    assert(numWhales == 1 && numNodes == 7);
+    /// The traversal controls of fused visitors are combined
+    pre.clear();
+    // clang-format off
+    completed = csp::traverse(std::as_const(*nodes[0]), children, csp::fuse{
+        [&](Animal const& node) {
+            pre.push_back(index(node));
+            return index(node) == 1 ? csp::traverse_control::skip_children :
+                                      csp::traverse_control::proceed;
+        },
+        [&](Animal const& node) {
+            return index(node) <= 1 ? csp::traverse_control::skip_children :
+                                      csp::traverse_control::proceed;
+        },
+    }); // clang-format on
+    assert(completed);
+    assert((pre == std::vector<size_t>{ 0, 1, 2, 5, 6 }));
+    pre.clear();
+    // clang-format off
+    completed = csp::traverse(std::as_const(*nodes[0]), children, csp::fuse{
+        [&](Animal const& node) {
+            pre.push_back(index(node));
+            return index(node) == 1 ? csp::traverse_control::skip_children :
+                                      csp::traverse_control::proceed;
+        },
+        [&](Animal const& node) {
+            switch (index(node)) {
+            case 1: return csp::traverse_control::skip_children;
+            case 5: return csp::traverse_control::stop;
+            default: return csp::traverse_control::proceed;
+            }
+        },
+    }); // clang-format on
+    assert(!completed);
+    assert((pre == std::vector<size_t>{ 0, 1, 2, 5 }));
+    /// Deep trees must not overflow the stack
+    std::vector<csp::unique_ptr<Animal>> chain;
+    for (size_t i = 0; i < 1'000'000; ++i) {
+        chain.push_back(csp::make_unique<Whale>());
+    }
+    size_t depth = 0;
+    csp::traverse(
+        *chain[0],
+        [&, next = size_t(1)](Animal&) mutable {
+        auto result = std::span(chain).subspan(next, next < chain.size());
+        ++next;
+        return result;
+    }, [&](Animal&) { ++depth; });
+    assert(depth == chain.size());
+}
+
+/// In the trees of `testDescendants()` leopards never have cetacean children
+template <>
+inline constexpr bool csp::may_contain<Leopard, Cetacea> = false;
+
+static void testDescendants() {
+    /// Node `i` has the children `2i + 1` and `2i + 2`
+    std::vector<csp::unique_ptr<Animal>> nodes;
+    nodes.push_back(csp::make_unique<Whale>());
+    nodes.push_back(csp::make_unique<Leopard>());
+    nodes.push_back(csp::make_unique<Dolphin>());
+    nodes.push_back(csp::make_unique<Leopard>());
+    nodes.push_back(csp::make_unique<Leopard>());
+    nodes.push_back(csp::make_unique<Whale>());
+    nodes.push_back(csp::make_unique<Leopard>());
+    size_t numExpanded = 0;
+    auto children = [&](Animal const& node) {
+        ++numExpanded;
+        size_t i = 0;
+        while (nodes[i].get() != &node) {
+            ++i;
+        }
+        std::vector<Animal const*> result;
+        for (size_t j : { 2 * i + 1, 2 * i + 2 }) {
+            if (j < nodes.size()) {
+                result.push_back(nodes[j].get());
+            }
+        }
+        return result;
+    };
+    Animal const& root = *nodes[0];
+    auto leopards = csp::descendants<Leopard>(root, children);
+    static_assert(std::ranges::input_range<decltype(leopards)>);
+    std::vector<Animal const*> found;
+    for (Leopard const& leopard : leopards) {
+        found.push_back(&leopard);
+    }
+    assert((found == std::vector<Animal const*>{ nodes[1].get(),
+                                                 nodes[3].get(),
+                                                 nodes[4].get(),
+                                                 nodes[6].get() }));
+    assert(numExpanded == 7);
+    /// The subtree of the leopard at index 1 is pruned
+    numExpanded = 0;
+    found.clear();
+    for (Cetacea const& cetacean : csp::descendants<Cetacea>(root, children)) {
+        found.push_back(&cetacean);
+    }
+    assert((found == std::vector<Animal const*>{ nodes[2].get(),
+                                                 nodes[5].get() }));
+    assert(numExpanded == 3);
+    /// Iteration stops early
+    numExpanded = 0;
+    auto itr = csp::descendants<Animal>(root, children).begin();
+    assert(&*itr == nodes[1].get());
+    assert(numExpanded == 2);
+}
+
+static void testTypeIndex() {
+    Dolphin dolphins[3];
+    Whale whales[2];
+    Leopard leopard;
+    csp::type_index<Animal> index;
+    index.insert(whales[0]);
+    for (auto& dolphin : dolphins) {
+        index.insert(dolphin);
+    }
+    index.insert(leopard);
+    index.insert(whales[1]);
+    assert(index.size() == 6);
+    auto cetacea = index.of<Cetacea>();
+    static_assert(std::ranges::forward_range<decltype(cetacea)>);
+    assert(cetacea.size() == 5);
+    assert(index.count<Dolphin>() == 3);
+    assert(std::ranges::distance(index.of<Animal>()) == 6);
+    /// Objects are grouped by type in the order of the type IDs
+    std::vector<Animal const*> found;
+    for (Cetacea& cetacean : cetacea) {
+        found.push_back(&cetacean);
+    }
+    assert((found == std::vector<Animal const*>{ &whales[0], &whales[1],
+                                                 &dolphins[0], &dolphins[1],
+                                                 &dolphins[2] }));
+    assert(index.erase(dolphins[0]));
+    assert(!index.erase(dolphins[0]));
+    assert(!index.contains(dolphins[0]));
+    assert(index.contains(dolphins[2]));
+    found.clear();
+    for (Dolphin& dolphin : index.of<Dolphin>()) {
+        found.push_back(&dolphin);
+    }
+    assert((found == std::vector<Animal const*>{ &dolphins[2], &dolphins[1] }));
+    assert(&*index.of<Leopard>().begin() == &leopard);
+    index.erase(leopard);
+    assert(index.of<Leopard>().empty());
+    index.clear();
+    assert(index.empty() && index.of<Animal>().empty());
+}
+
+/// Animals carry no data, so all animals of the same type are equal
+template <typename T>
+requires std::derived_from<T, Animal>
+struct csp::intern_hash<T> {
+    size_t operator()(T const&) const { return 0; }
+};
+
+template <typename T>
+requires std::derived_from<T, Animal>
+struct csp::intern_equal<T> {
+    bool operator()(T const&, T const&) const { return true; }
+};
+
+static void testInternTable() {
+    csp::intern_table<Animal> table;
+    Whale const* whale = table.make<Whale>();
+    assert(table.make<Whale>() == whale);
+    assert(table.intern(Whale{}) == whale);
+    Dolphin const* dolphin = table.make<Dolphin>();
+    assert((void const*)dolphin != (void const*)whale);
+    assert(table.size() == 2);
+    /// Dynamically typed objects are interned by their runtime type
+    csp::unique_ptr<Animal> animal = csp::make_unique<Dolphin>();
+    assert(table.intern(std::move(animal)) == dolphin);
+    Animal const* leopard = table.intern(csp::unique_ptr<Animal>(
+        csp::make_unique<Leopard>()));
+    assert(csp::isa<Leopard>(*leopard));
+    assert(table.size() == 3);
+    assert(table.is_canonical(*leopard));
+    assert(!table.is_canonical(Leopard{}));
+    assert(table.find(Leopard{}) == leopard);
+    table.clear();
+    assert(table.size() == 0 && !table.find(Leopard{}));
+}
+
+static void testMemoVisitor() {
+    /// Node `i` has the children `2i + 1` and `2i + 2`
+    Dolphin dolphins[4];
+    Whale whales[3];
+    std::vector<Animal const*> nodes = { &whales[0],   &dolphins[0],
+                                         &whales[1],   &dolphins[1],
+                                         &dolphins[2], &whales[2],
+                                         &dolphins[3] };
+    std::vector<int> weights = { 1, 2, 3, 4, 5, 6, 7 };
+    auto index = [&](Animal const& node) {
+        return size_t(std::find(nodes.begin(), nodes.end(), &node) -
+                      nodes.begin());
+    };
+    csp::memo_visitor<Animal const, int> memo;
+    /// Computes the sum of the weights of the subtree
+    std::function<int(Animal const&)> weight = [&](Animal const& node) {
+        return memo.visit(node, [&](Animal const& node) {
+            size_t i = index(node);
+            int result = weights[i];
+            for (size_t j : { 2 * i + 1, 2 * i + 2 }) {
+                if (j < nodes.size()) {
+                    result += weight(*nodes[j]);
+                }
+            }
+            return result;
+        });
+    };
+    assert(weight(*nodes[0]) == 28);
+    assert(memo.stats().misses == 7 && memo.stats().hits == 0);
+    assert(weight(*nodes[0]) == 28);
+    assert(memo.stats().misses == 7 && memo.stats().hits == 1);
+    /// Only the path from node 4 to the root is recomputed
+    weights[4] = 15;
+    memo.mark_dirty(*nodes[4]);
+    assert(!memo.is_cached(*nodes[0]) && !memo.is_cached(*nodes[1]));
+    assert(memo.is_cached(*nodes[2]) && memo.is_cached(*nodes[3]));
+    memo.reset_stats();
+    assert(weight(*nodes[0]) == 38);
+    assert(memo.stats().misses == 3 && memo.stats().hits == 2);
+    memo.forget(*nodes[6]);
+    assert(!memo.is_cached(*nodes[2]) && !memo.is_cached(*nodes[6]));
+    assert(memo.is_cached(*nodes[5]));
+    memo.clear();
+    assert(!memo.is_cached(*nodes[5]));
+    CHECK_THROWS(memo.visit(*nodes[3], [](auto&) -> int { throw 0; }));
+    assert(weight(*nodes[1]) == 21);
+}
+
+static void testMatch() {
+    using csp::any_node, csp::child, csp::is, csp::pattern, csp::rule;
+    Whale root, whale;
+    Dolphin dolphin;
+    Leopard leopard;
+    std::unordered_map<Animal const*, std::vector<Animal const*>> childTable = {
+        { &root, { &dolphin, &whale } },
+        { &whale, { &leopard, nullptr, &dolphin } },
+    };
+    size_t numExpanded = 0;
+    auto children = [&](Animal const& node) {
+        ++numExpanded;
+        auto itr = childTable.find(&node);
+        return itr != childTable.end() ? itr->second
+                                       : std::vector<Animal const*>{};
+    };
+    Animal const& animal = root;
+    assert(csp::matches(animal, children, is<Cetacea>));
+    assert(!csp::matches(animal, children, is<Leopard>));
+    assert(csp::matches(animal, children,
+                        pattern<Whale>(child<0>(is<Dolphin>),
+                                       child<1>(pattern<Whale>(
+                                           child<0>(is<Leopard>),
+                                           child<2>(any_node))))));
+    /// Null children and missing children do not match
+    assert(!csp::matches(animal, children,
+                         pattern<Whale>(child<1>(
+                             pattern<Whale>(child<1>(any_node))))));
+    assert(!csp::matches(animal, children,
+                         pattern<Whale>(child<2>(any_node))));
+    /// Nested child patterns address grandchildren without constraining the
+    /// type of the intermediate node
+    assert(csp::matches(animal, children,
+                        pattern<Whale>(child<1>(child<0>(is<Leopard>)),
+                                       child<1>(child<2>(is<Dolphin>)))));
+    assert(!csp::matches(animal, children,
+                         pattern<Whale>(child<1>(child<2>(is<Leopard>)))));
+    assert(!csp::matches(animal, children,
+                         pattern<Whale>(child<0>(child<0>(any_node)))));
+    assert(!csp::matches(animal, children,
+                         pattern<Whale>(child<1>(child<1>(any_node)))));
+    /// The first matching rule wins
+    numExpanded = 0;
+    auto result = csp::match(
+        animal, children,
+        rule(pattern<Whale>(child<0>(is<Leopard>)),
+             [](Whale const&) { return 1; }),
+        rule(pattern<Cetacea>(child<0>(is<Dolphin>), child<1>(is<Whale>)),
+             [](Cetacea const&) { return 2; }),
+        rule(is<Whale>, [](Whale const&) { return 3; }));
+    assert(result == 2);
+    /// Both children are read exactly once, which takes one call to
+    /// `children` each
+    assert(numExpanded == 2);
+    /// Positions that no candidate rule depends on are not read
+    numExpanded = 0;
+    result = csp::match(
+        animal, children,
+        rule(pattern<Leopard>(child<0>(any_node)),
+             [](Leopard const&) { return 1; }),
+        rule(any_node, [](Animal const&) { return 2; }));
+    assert(result == 2 && numExpanded == 0);
+    result = csp::match(static_cast<Animal const&>(leopard), children,
+                        rule(is<Cetacea>, [](Cetacea const&) { return 1; }));
+    assert(!result);
+    bool matched = false;
+    assert(csp::match(animal, children,
+                      rule(is<Whale>, [&](Whale const&) { matched = true; })));
+    assert(matched);
+}
+
+static void testRewriter() {
+    using ChildList = std::vector<csp::unique_ptr<Animal>>;
+    std::unordered_map<Animal const*, ChildList> childTable;
+    auto children = [&](Animal const& node) -> ChildList& {
+        return childTable[&node];
+    };
+    auto makeNode = [&]<typename T>(csp::unique_ptr<T> node,
+                                    ChildList children = {}) {
+        childTable[node.get()] = std::move(children);
+        return csp::unique_ptr<Animal>(std::move(node));
+    };
+    auto makeTree = [&] {
+        ChildList inner, outer;
+        inner.push_back(makeNode(csp::make_unique<Leopard>()));
+        inner.push_back(makeNode(csp::make_unique<Leopard>()));
+        outer.push_back(makeNode(csp::make_unique<Leopard>()));
+        outer.push_back(makeNode(csp::make_unique<Whale>(), std::move(inner)));
+        outer.push_back(makeNode(csp::make_unique<Dolphin>()));
+        return makeNode(csp::make_unique<Whale>(), std::move(outer));
+    };
+    /// Leopards become dolphins, and whales whose children are all dolphins
+    /// become dolphins as well
+    csp::rewriter rewriter{
+        csp::rewrite_rule<Leopard>([&](Leopard&) {
+            return makeNode(csp::make_unique<Dolphin>());
+        }),
+        csp::rewrite_rule<Whale>([&](Whale& whale) {
+            auto& kids = childTable[&whale];
+            if (!std::ranges::all_of(kids, csp::isa<Dolphin>)) {
+                return csp::unique_ptr<Animal>();
+            }
+            auto result = makeNode(csp::make_unique<Dolphin>(),
+                                   std::move(kids));
+            childTable.erase(&whale);
+            return result;
+        }),
+    };
+    auto root = makeTree();
+    auto stats = rewriter.run(root, children);
+    assert(stats.converged);
+    assert(stats.rewrites == 5);
+    assert((stats.firings == std::vector<size_t>{ 3, 2 }));
+    /// The six initial nodes and the five created dolphins. Children moved
+    /// into a replacement are not visited again
+    assert(stats.visited == 11);
+    assert(csp::isa<Dolphin>(*root));
+    assert(childTable[root.get()].size() == 3);
+    /// A second run only visits every node once
+    stats = rewriter.run(root, children);
+    assert(stats.rewrites == 0 && stats.visited == 6);
+    root = makeTree();
+    stats = rewriter.run(root, children, 1);
+    assert(!stats.converged && stats.rewrites == 1);
+}
+
+namespace {
+
+enum class TreeID { TNode, TLeaf, TPair };
+
+struct TNode: csp::base_helper<TNode, TreeID> {
+    using base_helper::base_helper;
+
+    std::array<TNode*, 2> children{};
+};
+
+struct TLeaf: TNode {
+    explicit TLeaf(int value): TNode(TreeID::TLeaf), value(value) {}
+
+    int value;
+};
+
+struct TPair: TNode {
+    TPair(TNode* lhs, TNode* rhs): TNode(TreeID::TPair) {
+        children = { lhs, rhs };
+    }
+
+    alignas(32) char tag = 'p';
+};
+
+} // namespace
+
+CSP_DEFINE(TNode, TreeID::TNode, void, Abstract)
+CSP_DEFINE(TLeaf, TreeID::TLeaf, TNode, Concrete)
+CSP_DEFINE(TPair, TreeID::TPair, TNode, Concrete)
+
+#if CSP_IMPL_HAS_PMR
+
+namespace {
+
+struct CountingResource: std::pmr::memory_resource {
+    void* do_allocate(size_t bytes, size_t align) override {
+        allocated += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+        deallocated += bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(
+        std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+
+    size_t allocated = 0;
+    size_t deallocated = 0;
+};
+
+} // namespace
+
+static void testPmrUniquePtr() {
+    CountingResource resource;
+    bool destroyed = false;
+    {
+        csp::pmr::unique_ptr<ScopeGuardBase> p =
+            csp::pmr::make_unique<ScopeGuardDerived>(&resource,
+                                                     [&] { destroyed = true; });
+        assert(resource.allocated == sizeof(ScopeGuardDerived));
+        auto q = csp::dyncast<ScopeGuardDerived>(std::move(p));
+        assert(q.get_deleter().resource() == &resource);
+    }
+    assert(destroyed);
+    assert(resource.deallocated == sizeof(ScopeGuardDerived));
+    /// Objects are destroyed through `do_destroy`
+    int i = 1;
+    csp::pmr::unique_ptr<ext_del::A> p =
+        csp::pmr::make_unique<ext_del::B>(&resource, &i);
+    assert(i == 42);
+    p.reset();
+    assert(i == 0 && ext_del::numDestroyed == 1);
+    assert(resource.deallocated == resource.allocated);
+}
+
+template <typename Root, typename Children>
+concept CanCloneTree = requires(Root& root, Children children) {
+    csp::clone_tree(root, children);
+};
+
+static void testClone() {
+    Whale whale;
+    Animal const& animal = whale;
+    csp::unique_ptr<Animal> copy = csp::clone(animal);
+    assert(csp::isa<Whale>(*copy) && copy.get() != &whale);
+
+    TLeaf a(1), b(2), c(3);
+    TPair inner(&b, nullptr), root(&a, &inner);
+    inner.children[1] = &c;
+    auto children = [](TNode& node) -> auto& { return node.children; };
+    CountingResource resource;
+    {
+        auto tree = csp::clone_tree(root, children, resource);
+        assert(resource.allocated == tree.allocated_bytes());
+        assert(tree.size() == 5);
+        std::vector<int> values;
+        for (TNode* node : tree.nodes()) {
+            auto* block = static_cast<std::byte*>((void*)tree.nodes().data());
+            auto* addr = reinterpret_cast<std::byte*>(node);
+            assert(addr >= block && addr < block + tree.allocated_bytes());
+            if (auto* pair = csp::dyncast<TPair*>(node)) {
+                assert((uintptr_t)pair % alignof(TPair) == 0);
+                assert(pair->tag == 'p');
+                continue;
+            }
+            values.push_back(csp::cast<TLeaf*>(node)->value);
+        }
+        assert((values == std::vector<int>{ 1, 2, 3 }));
+        TNode* copy = tree.root();
+        assert(copy != &root && csp::isa<TPair>(copy));
+        assert(copy->children[0] == tree.nodes()[1]);
+        assert(copy->children[1] == tree.nodes()[2]);
+        assert(tree.nodes()[2]->children[0] == tree.nodes()[3]);
+        assert(tree.nodes()[2]->children[1] == tree.nodes()[4]);
+        /// The source tree is unchanged
+        assert(root.children[0] == &a && inner.children[0] == &b);
+    }
+    assert(resource.deallocated == resource.allocated);
+    /// Only trees with mutable raw child pointers and a non-const source can be
+    /// cloned
+    using OwningChildren = std::vector<csp::unique_ptr<TNode>>& (*)(TNode&);
+    using ConstChildren = std::array<TNode const*, 2>& (*)(TNode&);
+    static_assert(CanCloneTree<TPair, decltype(children)>);
+    static_assert(!CanCloneTree<TPair const, decltype(children)>);
+    static_assert(!CanCloneTree<TNode, OwningChildren>);
+    static_assert(!CanCloneTree<TNode, ConstChildren>);
+}
+
+#endif // CSP_IMPL_HAS_PMR
+
 namespace unscoped {
 
 enum ID { ID_A, ID_B, ID_C };
@@ -1030,4 +1991,21 @@ int main() {
     testVisitMostDerivedClass();
     testExternalDeletion();
     testUniquePtr();
+    testRTTIColumn();
+    testVisitBatch();
+    testForEachHomogeneous();
+    testParallelVisit();
+    testParallelTraverse();
+    testFuse();
+    testTraverse();
+    testDescendants();
+    testTypeIndex();
+    testInternTable();
+    testMemoVisitor();
+    testMatch();
+    testRewriter();
+#if CSP_IMPL_HAS_PMR
+    testPmrUniquePtr();
+    testClone();
+#endif
 }